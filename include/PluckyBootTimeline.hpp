@@ -0,0 +1,20 @@
+#ifndef _PLUCKY_BOOT_TIMELINE_HPP_
+#define _PLUCKY_BOOT_TIMELINE_HPP_
+
+#include <Arduino.h>
+
+#define BOOT_MAX_MILESTONES 16
+
+// Timestamped startup milestones ("UART bridge live", "SPIFFS mounted", "WiFi connected",
+// ...), logged on the serial console as they are reached and listed at /boot.  Times are
+// micros() since reset, so the first entry also shows how long the bootloader took.
+//
+// Each milestone is recorded the first time only, so call sites on paths that repeat
+// (WiFi reconnects, every DE1 frame) need no guard of their own.  name must outlive the
+// program (a string literal); it is compared and kept by pointer.  Safe to call from the
+// bridge task as well as loop().
+void bootMilestone(const char *name);
+// One line per milestone: time since reset and since the previous milestone, in ms
+void bootTimelinePrint(Print &out);
+
+#endif // _PLUCKY_BOOT_TIMELINE_HPP_
@@ -0,0 +1,42 @@
+#ifndef _PLUCKY_BRIDGE_TASK_HPP_
+#define _PLUCKY_BRIDGE_TASK_HPP_
+
+#include <Arduino.h>
+
+#include "config.hpp"
+
+class PluckyInterface;
+class PluckyInterfaceSerial;
+
+// Dual-core mode (ENABLE_DUAL_CORE_BRIDGE): the UART interfaces are serviced by a
+// dedicated high-priority FreeRTOS task pinned to BRIDGE_TASK_CORE, while loop()
+// keeps the web server and TCP work on the other core.  Frames crossing between the
+// two sides travel through PluckySpscQueue instances:
+//  - UART -> TCP: PluckyInterfaceCrossCore wraps the loop-side interfaces
+//  - TCP/web -> UART: PluckyInterfaceSerial queues writes made from outside the bridge task
+//
+// The task either polls its UARTs once per tick, or (ENABLE_UART_EVENT_RX) sleeps until
+// a UART's HardwareSerial::onReceive callback wakes it.
+
+// Starts the bridge task, which calls doLoop() on each of the given interfaces.
+// simulated, if given, is an interface with no UART behind it (the DE1 simulator),
+// serviced on every tick alongside them.
+void bridgeTaskBegin(PluckyInterfaceSerial **interfaces, uint8_t numInterfaces, PluckyInterface *simulated=NULL);
+
+// True once bridgeTaskBegin() has started the task
+bool bridgeTaskRunning();
+
+// True when called from the bridge task itself
+bool inBridgeTask();
+
+// Wakes the bridge task early, e.g. after queueing a frame for one of its UARTs
+void bridgeTaskWake();
+
+// Notes how long after HardwareSerial signalled received data the bridge task read it
+void bridgeTaskRecordRxWait(uint32_t us);
+
+// Prints (and resets) wakeup, busy-time and receive-wait counters, for comparing polled
+// and event-driven receive
+void bridgeTaskPrintStats(Print &out);
+
+#endif // _PLUCKY_BRIDGE_TASK_HPP_
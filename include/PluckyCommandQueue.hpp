@@ -0,0 +1,55 @@
+#ifndef _PLUCKY_COMMAND_QUEUE_HPP_
+#define _PLUCKY_COMMAND_QUEUE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "PluckySpscQueue.hpp"
+#include "config.hpp"
+
+// Senders of DE1-bound frames, each with a lane of its own in the command queue
+#define DE1_QUEUE_LANE_OTHER 0      // writes with no particular sender (web handlers, filter taps, ...)
+#define DE1_QUEUE_LANE_USB 1
+#define DE1_QUEUE_LANE_BLE 2
+#define DE1_QUEUE_LANE_WEBSOCKET 3
+#define DE1_QUEUE_LANE_TCP_BASE 4   // TCP slot n uses lane DE1_QUEUE_LANE_TCP_BASE + n % DE1_QUEUE_TCP_LANES
+#define DE1_QUEUE_TCP_LANES 6
+#define DE1_QUEUE_NUM_LANES (DE1_QUEUE_LANE_TCP_BASE + DE1_QUEUE_TCP_LANES)
+
+struct PluckyCommandLaneStats {
+  uint32_t queued;   // frames accepted into the lane
+  uint32_t dropped;  // frames refused because the lane was full (or the frame too long)
+  uint32_t sent;     // frames written to the UART
+};
+
+// Frames on their way to the DE1 UART, one bounded FIFO per sender, drained round-robin
+// as the UART's TX buffer frees up.  A burst from one controller fills only its own lane,
+// so it can neither starve another controller's wake/sleep commands nor get them dropped.
+//
+// Each lane is a single-producer queue: USB and BLE lanes are fed by whichever task
+// services those UARTs, the TCP and WebSocket lanes by loop(), and the "other" lane by
+// the DE1 UART's owner only.  next()/pop() must be called by the DE1 UART's owner.
+class PluckyCommandQueue {
+public:
+  PluckyCommandQueue();
+
+  // Queues prefix + buf on lane.  Returns false (and counts a drop) if it doesn't fit.
+  bool push(uint8_t lane, const uint8_t *prefix, size_t prefixLen, const uint8_t *buf, size_t len);
+
+  // The frame whose turn it is, or NULL if every lane is empty.  Stays valid until pop().
+  const uint8_t *next(size_t *len);
+  // Removes the frame next() returned and moves on to the following lane
+  void pop();
+
+  bool empty();
+  const PluckyCommandLaneStats &getStats(uint8_t lane) { return _stats[lane]; }
+  static const char *laneName(uint8_t lane, char *buf, size_t size);
+
+protected:
+  PluckySpscQueue<DE1_COMMAND_QUEUE_DEPTH, READ_BUFFER_SIZE> _lanes[DE1_QUEUE_NUM_LANES];
+  PluckyCommandLaneStats _stats[DE1_QUEUE_NUM_LANES];
+  uint8_t _turn;     // lane next() looks at first
+  uint8_t _current;  // lane next() last returned from
+};
+
+#endif // _PLUCKY_COMMAND_QUEUE_HPP_
@@ -0,0 +1,44 @@
+#ifndef _PLUCKY_DE1_STATE_HPP_
+#define _PLUCKY_DE1_STATE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "PluckyInterface.hpp"
+
+// Longest DE1 frame worth caching: "[X]" + 20 bytes of hex + "\n", with room to spare.
+// Longer frames are passed through but not cached.
+#define DE1_STATE_FRAME_SIZE 64
+
+// Latest-value cache of DE1 frames, one per message tag.  Some tags (e.g. [N] state,
+// [Q] water levels) only arrive on change, so a client that connects late would otherwise 
+// know nothing until the machine happens to send them again.
+//
+// Updated by whoever reads the DE1 UART (loop() or the bridge task) and read from loop()
+// by the TCP port and web server, so each slot is guarded by a sequence lock: readers
+// retry rather than ever blocking the DE1 path.
+class PluckyDe1State {
+public:
+  PluckyDe1State();
+
+  // Records buf if it is a tagged DE1 frame
+  void update(const uint8_t *buf, size_t size);
+
+  // Copies the latest frame for tag index (see frameTagIndex()) into buf, which must hold 
+  // DE1_STATE_FRAME_SIZE bytes.  Returns its length, or 0 if none has been seen.
+  size_t get(int tag, uint8_t *buf);
+
+  // Writes every cached frame to dest, in tag order.  Returns the number of frames written.
+  uint16_t writeSnapshot(PluckyInterface *dest);
+
+protected:
+  struct Slot {
+    std::atomic<uint32_t> seq;   // odd while being written
+    uint8_t len;
+    uint8_t data[DE1_STATE_FRAME_SIZE];
+  };
+  Slot _slots[DE1_NUM_TAGS];
+};
+
+#endif // _PLUCKY_DE1_STATE_HPP_
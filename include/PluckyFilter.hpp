@@ -0,0 +1,119 @@
+#ifndef _PLUCKY_FILTER_HPP_
+#define _PLUCKY_FILTER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include <Arduino.h>
+#include "PluckyInterface.hpp"
+#include "PluckyRouter.hpp"
+
+// Per-frame inspection stage every received frame goes through before it is routed.
+//
+// Rules match on a frame prefix and are compiled into a trie whose edges live in a hash
+// table, so a frame is inspected in one pass over at most its first FILTER_PATTERN_SIZE
+// bytes at one lookup per byte, no matter how many rules there are or how many share a
+// first character.  DE1 frames, whose first byte no rule starts with, cost one lookup.
+// Rules are written one per line as
+//   <sources> <prefix> <action> [argument]
+// where sources is "*" or a comma separated list of DE1, USB, BLE, TCP and WS, and
+// action is one of
+//   drop                  discard the frame
+//   rewrite <text>        replace the matched prefix with text
+//   tap <endpoint>        also send the frame to DE1, USB, BLE, TCP, WS or UDP
+//   count                 just count matches
+//   command <name>        handle the frame locally instead of forwarding it:
+//                         heap (log free heap), bridge (log bridge task stats) or
+//                         reinit (re-initialize the DE1)
+// Every rule matching a frame applies, in rule order, until one drops it.  Lines
+// starting with '#' are comments.  The built-in rules (HEAP, BRIDGE, the P05
+// workaround) come first, followed by those in FILTER_RULES_PATH in SPIFFS, which
+// can be viewed and replaced at /filters.
+//
+// compile() builds into whichever of two tables is not in use and then switches, so
+// the bridge task can keep filtering while loop() recompiles.  Each table counts the
+// run()s reading it, and compile() waits for any still on the inactive table (from
+// before the previous switch) to finish before overwriting it.
+
+#define FILTER_RULES_PATH "/filters.txt"
+#define FILTER_MAX_RULES 32
+#define FILTER_MAX_NODES 128
+#define FILTER_EDGE_SLOTS 256  // power of two, at least twice FILTER_MAX_NODES
+#define FILTER_PATTERN_SIZE 24
+#define FILTER_ARG_SIZE 24
+
+#define FILTER_ACTION_DROP 0
+#define FILTER_ACTION_REWRITE 1
+#define FILTER_ACTION_TAP 2
+#define FILTER_ACTION_COUNT 3
+#define FILTER_ACTION_COMMAND 4
+
+#define FILTER_COMMAND_HEAP 0
+#define FILTER_COMMAND_BRIDGE 1
+#define FILTER_COMMAND_REINIT 2
+
+struct PluckyFilterRule {
+  char pattern[FILTER_PATTERN_SIZE];
+  char arg[FILTER_ARG_SIZE];  // rewrite text
+  uint8_t patternLen;
+  uint8_t argLen;
+  uint8_t action;
+  uint8_t target;             // tap endpoint or command
+  uint8_t sources;            // ROUTE_BIT mask
+  uint32_t hits;
+};
+
+class PluckyFilter {
+public:
+  PluckyFilter();
+
+  // Builds the table from the built-in rules followed by rules (may be NULL).
+  // Returns the number of rules in effect.
+  int compile(const char *rules);
+  // Compiles rules as compile() would without putting them in effect, listing each line
+  // that would be skipped (unparseable, or no room left for it) on out.  Returns how many.
+  int check(const char *rules, Print &out);
+
+  // Filters a frame received on endpoint source (a ROUTE_* id) in place: converts a CRLF
+  // line ending to LF, applies the matching rules and null-terminates the result.  buf
+  // must have room for READ_BUFFER_SIZE bytes.  Returns the new length; 0 means the frame
+  // was consumed and must not be forwarded.
+  uint16_t run(uint8_t source, uint8_t *buf, uint16_t len, const char *interfaceName, PluckyInterfaceStats &stats);
+
+  // Lists the rules in effect with their hit counts, in the rule file format
+  void printRules(Print &out);
+
+protected:
+  struct Node {
+    uint32_t rules;    // bitmask of rules whose pattern ends here
+    uint16_t parent;
+    uint8_t c;         // the byte on the edge from parent
+  };
+
+  struct Table {
+    PluckyFilterRule rules[FILTER_MAX_RULES];
+    uint8_t numRules;
+    Node nodes[FILTER_MAX_NODES];  // nodes[0] is the root
+    uint16_t numNodes;
+    uint16_t edges[FILTER_EDGE_SLOTS];  // open addressed on (parent, c); 0 = empty
+    uint32_t sourceRules[ROUTE_NUM_ENDPOINTS];
+  };
+
+  Table _tables[2];
+  std::atomic<Table *> _active;
+  std::atomic<uint16_t> _readers[2];  // run()s and printRules()s in progress on each table
+
+  Table *_acquire();
+  void _release(Table *table);
+  uint16_t _run(Table &table, uint8_t source, uint8_t *buf, uint16_t len, const char *interfaceName, PluckyInterfaceStats &stats);
+
+  static bool _parseRule(const char *line, PluckyFilterRule &rule);
+  Table &_clearInactive();
+  static int _addRules(Table &table, const char *rules, Print *rejects=NULL);
+  static bool _insert(Table &table, uint8_t index);
+  static uint16_t _child(const Table &table, uint16_t parent, uint8_t c);
+  void _runCommand(const PluckyFilterRule &rule, const uint8_t *buf, uint16_t len, const char *interfaceName);
+};
+
+#endif // _PLUCKY_FILTER_HPP_
@@ -0,0 +1,74 @@
+#ifndef _PLUCKY_FLIGHT_RECORDER_HPP_
+#define _PLUCKY_FLIGHT_RECORDER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// In-RAM flight recorder: the last TRACE_NUM_RECORDS frames received on any interface,
+// timestamped, so that "BLE dropped mid-shot" can be looked at after the fact.
+// Download with GET /trace and decode with tools/plucky_trace.py.
+//
+// Recording is a fetch-add to reserve a slot plus a fixed-size copy; there is no
+// allocation and no lock, so it can be called from loop() and the bridge task alike.
+
+#define TRACE_NUM_RECORDS 256  // power of two
+#define TRACE_PAYLOAD_SIZE 36
+
+// Interface IDs used as record source / destination
+#define TRACE_ID_NONE 0
+#define TRACE_ID_DE1 1
+#define TRACE_ID_USB 2
+#define TRACE_ID_BLE 3
+#define TRACE_ID_WEBSOCKET 4
+#define TRACE_ID_CONTROLLERS 15  // broadcast to all controllers
+#define TRACE_ID_TCP_BASE 16     // TCP slot n is TRACE_ID_TCP_BASE + n
+
+#define TRACE_FLAG_TRUNCATED 0x01  // frame was longer than TRACE_PAYLOAD_SIZE
+
+// On-the-wire layout of the downloaded trace: one header followed by up to
+// TRACE_NUM_RECORDS records, oldest first.  All fields little-endian.
+#define TRACE_MAGIC 0x544b4c50  // "PLKT"
+#define TRACE_VERSION 1
+
+struct __attribute__((packed)) PluckyTraceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t numRecords;   // records that follow
+  uint32_t totalRecorded;  // frames recorded since boot (older ones were overwritten)
+  uint32_t nowUs;        // micros() when the trace was taken, to relate timestamps to "now"
+};
+
+struct __attribute__((packed)) PluckyTraceRecord {
+  uint32_t seq;          // position in the overall sequence; lets the decoder spot torn records
+  uint32_t timestampUs;  // micros() when the frame was received
+  uint8_t source;        // TRACE_ID_*
+  uint8_t dest;          // TRACE_ID_*
+  uint8_t len;           // full frame length (saturates at 255)
+  uint8_t flags;         // TRACE_FLAG_*
+  uint8_t payload[TRACE_PAYLOAD_SIZE];
+};
+
+class PluckyFlightRecorder {
+public:
+  PluckyFlightRecorder();
+
+  void record(uint8_t source, uint8_t dest, const uint8_t *buf, size_t len);
+
+  // While frozen, record() is a no-op so the buffer can be read out consistently
+  void freeze() { _frozen.store(true, std::memory_order_release); }
+  void resume() { _frozen.store(false, std::memory_order_release); }
+
+  // Size of the complete trace (header + records) as writeTrace() will produce it
+  size_t traceSize();
+  // Hands the trace to sink in up to three contiguous pieces.  Call while frozen.
+  void writeTrace(void (*sink)(const uint8_t *buf, size_t len, void *ctx), void *ctx);
+
+protected:
+  PluckyTraceRecord _records[TRACE_NUM_RECORDS];
+  std::atomic<uint32_t> _next;
+  std::atomic<bool> _frozen;
+};
+
+#endif // _PLUCKY_FLIGHT_RECORDER_HPP_
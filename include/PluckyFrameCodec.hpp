@@ -0,0 +1,38 @@
+#ifndef _PLUCKY_FRAME_CODEC_HPP_
+#define _PLUCKY_FRAME_CODEC_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Conversion between the DE1's ASCII-hex frames and the packed binary framing
+// that TCP clients can opt into (see PluckyInterfaceTcpClient).
+//
+// A packed frame is:
+//
+//   len | kind | tag | data...
+//
+// where len counts the bytes that follow it.  kind is the opening bracket
+// ('[' or '<') and tag the message letter, so "[M]0102AB\n" packs to
+// 05 '[' 'M' 01 02 AB.  Lines that are not bracket + tag + hex (e.g. "{Serial_BLE} ..."
+// promiscuous broadcasts, or "!" control lines) travel as kind PACKED_KIND_TEXT,
+// with the line minus its '\n' as the data and no tag byte.
+#define PACKED_KIND_TEXT 0
+
+// 1 length byte + up to 255 following bytes
+#define PACKED_FRAME_MAX_SIZE 256
+
+// Packs prefix + ascii (a '\n'-terminated frame) into out, which must have room for
+// PACKED_FRAME_MAX_SIZE bytes.  If a prefix is given the frame is always sent as text.
+// Returns the packed size, or 0 if the frame is too long to pack.
+size_t packFrame(const uint8_t *prefix, size_t prefixLen, const uint8_t *ascii, size_t len, uint8_t *out);
+
+// Unpacks one complete packed frame into a '\n'-terminated ASCII frame.
+// Returns the ASCII length, or 0 if the frame is malformed or does not fit in outSize.
+size_t unpackFrame(const uint8_t *packed, size_t len, uint8_t *out, size_t outSize);
+
+// The byte in the two hex digits after a three-character tag such as "[N]" or "<B>",
+// e.g. the machine state in "[N]0200\n".  open is '[' or '<'.  Returns -1 if the frame
+// does not start with open, tag, the matching close bracket and two hex digits.
+int frameTagByte(const uint8_t *ascii, size_t len, uint8_t open, uint8_t tag);
+
+#endif // _PLUCKY_FRAME_CODEC_HPP_
@@ -1,11 +1,38 @@
 #ifndef _PLUCKY_INTERFACE_HPP_
 #define _PLUCKY_INTERFACE_HPP_
 
+#include <string.h>
 #include <ArduinoSimpleLogging.h>
 #include "config.hpp"
 
+// Running totals kept by every interface and served at /metrics.  Plain 32-bit counters:
+// they are bumped by whichever task is driving the interface and a 32-bit read from the 
+// web server can't tear.  In dual-core mode an occasional increment could be lost if both
+// cores count the same event at once, which is fine for monitoring.
+struct PluckyInterfaceStats {
+  uint32_t bytesIn;
+  uint32_t bytesOut;
+  uint32_t framesIn;
+  uint32_t framesOut;
+  uint32_t writeDrops;  // frames that could not be written (buffer or queue full)
+  uint32_t overruns;    // read buffer overrun purges
+  uint32_t crlfFixes;   // CRLF line endings converted to LF
+  uint32_t filterDrops; // frames dropped or handled locally by PluckyFilter rules
+  uint32_t connects;    // clients accepted (TCP / WebSocket servers)
+  uint32_t rejects;     // clients turned away for lack of a free slot
+  uint32_t evictions;   // clients disconnected to make room for a new one (TCP)
+  uint32_t timeouts;    // clients disconnected for being idle (TCP)
+};
+
+class PluckyInterface;
+// Called once per leaf interface by visitStats()
+typedef void (*PluckyStatsVisitor)(const char *name, const PluckyInterfaceStats &stats, void *ctx);
+
 class PluckyInterface {
 public:
+  PluckyInterface() { memset(&_stats, 0, sizeof(_stats)); }
+  virtual ~PluckyInterface() { }
+
   virtual void doInit() = 0;
   virtual void doLoop() = 0;
 
@@ -15,11 +42,40 @@ public:
   virtual bool readAll() = 0;
   virtual bool availableForWrite(size_t len=0) = 0;
   virtual bool writeAll(const uint8_t *buf, size_t size) = 0;
+  // Writes prefix followed by buf as one message, e.g. a promiscuous "{Serial_BLE} " broadcast,
+  // without the caller having to assemble the two in a scratch buffer first
+  virtual bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) = 0;
+  // Writes on behalf of a particular sender (a DE1_QUEUE_LANE_*), for interfaces that
+  // share their output fairly between senders.  Others just write.
+  virtual bool writeAllFrom(uint8_t sender, const uint8_t *buf, size_t size) { return writeAll(buf, size); }
 
+  virtual const char *getName() = 0;
+  PluckyInterfaceStats &getStats() { return _stats; }
+  // Reports this interface's counters to fn; groups report each of their children instead
+  virtual void visitStats(PluckyStatsVisitor fn, void *ctx) { fn(getName(), _stats, ctx); }
+
+protected:
+  // Passes on a frame this interface received as endpoint routeId (a ROUTE_*): the flight
+  // recorder, the filters and, for DE1 frames, the DE1 state cache and (recordShot) the
+  // shot recorder, then the routing table.  The filters may rewrite frame in place, so it
+  // must have room for READ_BUFFER_SIZE bytes.
+  void _receiveFrame(uint8_t routeId, uint8_t traceId, uint8_t lane, const char *prefix, size_t prefixLen,
+                     uint8_t *frame, uint16_t len, bool recordShot);
+
+  PluckyInterfaceStats _stats;
 };
 
-// helper functions 
-void trimBuffer(uint8_t *buf, uint16_t &len, char *interfaceName);
-void debugHandler(uint8_t *buf, uint16_t &len);
+// Room for "{" + 31 character interface name + "} " + null
+#define PROMISCUOUS_PREFIX_SIZE 36
+
+// DE1 frames look like "[X]<hex>\n", with the tag X between '@' and DEL.
+// Returns X - '@' (0..63), or -1 if buf is not a tagged DE1 frame.
+#define DE1_NUM_TAGS 64
+inline int frameTagIndex(const uint8_t *buf, size_t size) {
+  if (size < 3 || buf[0] != '[' || buf[2] != ']' || buf[1] < '@' || buf[1] > 0x7F) {
+    return -1;
+  }
+  return buf[1] - '@';
+}
 
 #endif // _PLUCKY_INTERFACE_HPP_
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef _PLUCKY_INTERFACE_CROSS_CORE_HPP_
+#define _PLUCKY_INTERFACE_CROSS_CORE_HPP_
+
+#include "PluckyInterface.hpp"
+#include "PluckySpscQueue.hpp"
+#include "config.hpp"
+
+// Wraps a loop()-side interface (e.g. the TCP port) so that it can sit in the
+// controllers group while the UARTs are serviced by the bridge task.
+// Writes made from the bridge task are queued and replayed into the wrapped
+// interface by doLoop() on the loop() core; writes from loop() itself go straight through.
+class PluckyInterfaceCrossCore : public PluckyInterface {
+public:
+  PluckyInterfaceCrossCore(PluckyInterface *wrapped);
+  ~PluckyInterfaceCrossCore();
+
+  void doInit();
+  void doLoop();
+
+  void begin();
+  void end();
+  bool available();
+  bool readAll();
+  bool availableForWrite(size_t len=0);
+  bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+
+  // Reports as "<wrapped name>_crosscore", counting frames dropped at the cross-core queue
+  const char *getName() { return _name; }
+  void visitStats(PluckyStatsVisitor fn, void *ctx);
+
+  PluckyInterface *getWrapped() { return _wrapped; }
+
+protected:
+  PluckyInterface *_wrapped;
+  PluckySpscQueue<BRIDGE_QUEUE_DEPTH, BRIDGE_FRAME_SIZE> _fromBridge;
+  uint32_t _drops;
+  char _name[32];
+};
+
+#endif // _PLUCKY_INTERFACE_CROSS_CORE_HPP_
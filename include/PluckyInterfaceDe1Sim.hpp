@@ -0,0 +1,104 @@
+#ifndef _PLUCKY_INTERFACE_DE1_SIM_HPP_
+#define _PLUCKY_INTERFACE_DE1_SIM_HPP_
+
+#include <atomic>
+
+#include "PluckyInterface.hpp"
+#include "config.hpp"
+
+// Stands in for the DE1 UART (ENABLE_DE1_SIMULATOR, or the native bench), so the
+// routing, queues and web serving can be loaded repeatably without a machine.
+//
+// It answers <B> state requests the way the DE1 does, with an [N] frame for each
+// state it goes through: <B>00 goes to sleep by way of GoingToSleep, anything else is
+// entered at once.  Requesting Espresso replays a shot: a recording in the
+// PluckyShotRecorder layout (see /shots) handed to load(), or else a built-in synthetic
+// one.  Frames come out with the recorded spacing, N times faster, or as fast as
+// doLoop() is called (setSpeed()), and go through the same flight recorder, filters,
+// DE1 state cache and routing as frames from the real UART.  They are not recorded as
+// shots unless DE1_SIM_RECORD_SHOTS is set, so a bench session doesn't push real
+// recordings off the flash.  When the shot runs out (or there is none) the machine goes
+// back to Idle, or (setRepeat()) starts it over.
+//
+// writeAll() and load() may be called from either core in dual-core mode; they only
+// hand the request or shot over, and the next doLoop() acts on it (a new shot once any
+// replay in progress is over).  Of several requests made between two doLoop()s, the
+// last one wins.
+
+#define DE1_STATE_SLEEP 0
+#define DE1_STATE_GOING_TO_SLEEP 1
+#define DE1_STATE_IDLE 2
+// DE1_STATE_ESPRESSO is in PluckyShotRecorder.hpp
+
+#define DE1_SIM_SLEEP_DELAY_MS 1000  // time spent in GoingToSleep
+#define DE1_SIM_BURST 16             // most frames sent per doLoop(), however far behind
+
+// The built-in shot: DE1_SIM_SYNTH_SHOT_MS of [M] shot samples every DE1_SIM_SYNTH_SAMPLE_MS
+#define DE1_SIM_SYNTH_SHOT_MS 30000
+#define DE1_SIM_SYNTH_SAMPLE_MS 250
+
+class PluckyInterfaceDe1Sim : public PluckyInterface {
+public:
+  PluckyInterfaceDe1Sim();
+  ~PluckyInterfaceDe1Sim();
+
+  void doInit();
+  void doLoop();
+
+  void begin();
+  void end();
+  bool available();
+  bool readAll();
+  bool availableForWrite(size_t len=0) { return true; }
+  bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+
+  const char *getName() { return "Sim_DE1"; }
+
+  // The shot to replay: a whole recording as downloaded from /shot?n=.  Not copied, so
+  // data must stay put.  False (and the current shot kept) if it isn't a recording.
+  bool load(const uint8_t *data, size_t len);
+  // 1 = the recorded timing, N = N times faster, 0 = as fast as doLoop() runs
+  void setSpeed(uint16_t speed) { _speed = speed; }
+  // true = start the shot over when it ends, rather than going back to Idle
+  void setRepeat(bool repeat) { _repeat = repeat; }
+
+  uint8_t getState() { return _state; }
+  bool playing() { return _playing; }
+  // Shots replayed to the end
+  uint32_t getReplays() { return _replays; }
+
+protected:
+  void _buildSyntheticShot();
+  void _request(uint8_t state, uint32_t now);
+  void _enterState(uint8_t state);
+  void _play(uint32_t now);
+  void _emit(size_t len);
+
+  std::atomic<int16_t> _requested;  // state asked for by writeAll(), or -1
+  std::atomic<bool> _shotLoaded;     // load() has left a new shot in _loaded*
+  const uint8_t *_loadedRecords;
+  size_t _loadedLen;
+
+  const uint8_t *_records;  // the shot's records, between its header and trailer
+  size_t _recordsLen;
+  uint8_t *_synthetic;      // the built-in shot's records, when nothing was loaded
+  size_t _pos;
+  bool _playing;
+  uint32_t _playStartMs;
+  uint32_t _playedMs;       // recorded time up to the record at _pos
+
+  uint8_t _state;
+  bool _sleepPending;
+  uint32_t _sleepAtMs;
+
+  uint16_t _speed;
+  bool _repeat;
+  uint32_t _replays;
+
+  uint8_t _readBuf[READ_BUFFER_SIZE];
+  char _promiscuousPrefix[PROMISCUOUS_PREFIX_SIZE];
+  uint8_t _promiscuousPrefixLen;
+};
+
+#endif // _PLUCKY_INTERFACE_DE1_SIM_HPP_
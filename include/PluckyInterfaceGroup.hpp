@@ -2,6 +2,7 @@
 #define _PLUCKY_INTERFACE_GROUP_HPP_
 
 #include "PluckyInterface.hpp"
+#include "PluckyProfiler.hpp"
 
 class PluckyInterfaceGroup : public PluckyInterface {
 public:
@@ -9,6 +10,8 @@ public:
   ~PluckyInterfaceGroup();
   
   void doInit();
+  // doInit() for child i alone, for children added after the rest of the group is running
+  void initChild(uint16_t i);
   void doLoop();
 
   void begin();
@@ -17,6 +20,10 @@ public:
   bool readAll();
   bool availableForWrite(size_t len=0);
   bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+
+  const char *getName() { return "Group"; }
+  void visitStats(PluckyStatsVisitor fn, void *ctx);
 
   uint8_t getNumInterfaces();
 
@@ -33,8 +40,17 @@ public:
   PluckyInterface *& operator [](int i) {return _interfaces[i];}
 
 protected:
+  // Name child i is reported under in /metrics and /profile
+  virtual void _childName(uint16_t i, char *buf, size_t size);
+  void _loopChild(uint16_t i) {
+    uint32_t start = profilerNow();
+    _interfaces[i]->doLoop();
+    _loopHistograms[i].record(profilerNow() - start);
+  }
+
   uint8_t _numInterfaces;
   PluckyInterface **_interfaces;
+  PluckyLatencyHistogram *_loopHistograms;  // one per child, timing its doLoop()
 };
 
 
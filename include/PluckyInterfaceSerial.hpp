@@ -6,6 +6,9 @@
 #include <ArduinoSimpleLogging.h>
 
 #include "PluckyInterface.hpp"
+#include "PluckyRingBuffer.hpp"
+#include "PluckySpscQueue.hpp"
+#include "PluckyCommandQueue.hpp"
 #include "config.hpp"
 
 //#define EXTERNAL_DEBUG
@@ -13,6 +16,15 @@
 #define UART_BAUD 115200
 #define SERIAL_PARAM SERIAL_8N1
 
+// Receive staging area drained from the UART driver in bulk by readAll().
+// Must be at least READ_BUFFER_SIZE; a few frames' worth lets one readAll()
+// empty the driver's RX buffer in a couple of read() calls.
+#define SERIAL_RX_RING_SIZE 512
+
+// Most TX buffer space HardwareSerial::availableForWrite() reports on an empty UART;
+// longer frames can never be queued for their turn, only written (or dropped) directly
+#define SERIAL_TX_BUFFER_SIZE 127
+
 #define SERIAL_USB_UART_NUM UART_NUM_0
 
 #define SERIAL_DE_UART_NUM UART_NUM_1
@@ -54,13 +66,45 @@ public:
   bool readAll();
   bool availableForWrite(size_t len=0);
   bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+  bool writeAllFrom(uint8_t sender, const uint8_t *buf, size_t size);
+
+  const char *getName() { return _interfaceName; }
+  // The DE1 UART's fair queue of frames from each sender; NULL on the other UARTs
+  PluckyCommandQueue *getCommandQueue() { return _commands; }
+  bool hasQueuedCommands() { return _commands && !_commands->empty(); }
+
+
+  // BLE UART only: switches CTS/RTS flow control to match the bleFlowControl setting.
+  // Safe while the bridge task is using the UART; the IDF driver serializes register access.
+  void applyFlowControl();
 
 private:
+  static void _settingsChanged_CB(uint32_t changed, void *ctx);
+  void _handleFrame(uint16_t sendLen);
+  bool _ownsUart();
+  bool _writeUart(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+  bool _queueCommand(uint8_t lane, const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+  void _drainCommands();
+
   HardwareSerial *_serial;
+  PluckyRingBuffer<SERIAL_RX_RING_SIZE> _rxRing;
+  PluckyCommandQueue *_commands;
+  uint8_t _commandLane;  // DE1_QUEUE_LANE_* this interface's frames use on the DE1
+#if ENABLE_DUAL_CORE_BRIDGE
+  PluckySpscQueue<BRIDGE_QUEUE_DEPTH, BRIDGE_FRAME_SIZE> _txFromLoop;  // writes made by loop() while the bridge task owns the UART
+#endif // ENABLE_DUAL_CORE_BRIDGE
+#if ENABLE_DUAL_CORE_BRIDGE
+  void _beginRxSignal();
+  volatile uint32_t _rxSignalledUs;  // micros() | 1 when HardwareSerial signalled data not yet read, else 0
+#endif // ENABLE_DUAL_CORE_BRIDGE
   uint8_t _readBuf[READ_BUFFER_SIZE];
-  uint16_t _readBufIndex;
   int _uart_nr;
+  uint8_t _traceId;  // TRACE_ID_* for the flight recorder
+  uint8_t _routeId;  // ROUTE_* endpoint this interface is in the routing table
   char _interfaceName[32];
+  char _promiscuousPrefix[PROMISCUOUS_PREFIX_SIZE];  // "{_interfaceName} ", rendered when the name is set
+  uint8_t _promiscuousPrefixLen;
 
 };
 
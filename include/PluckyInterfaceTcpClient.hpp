@@ -1,17 +1,71 @@
 #ifndef _PLUCKY_INTERFACE_TCP_CLIENT_HPP_
 #define _PLUCKY_INTERFACE_TCP_CLIENT_HPP_
 
-#include <WifiServer.h>
-#include <WifiClient.h>
+#include <WiFiServer.h>
+#include <WiFiClient.h>
 
 #include "PluckyInterface.hpp"
+#include "PluckyRingBuffer.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyCommandQueue.hpp"
 #include "config.hpp"
 
+// Outbound bytes are queued per client and sent without blocking from doLoop(),
+// so a slow or half-dead client cannot stall the bridge for everyone else.
+// Sized to hold a couple of seconds of shot telemetry.
+#define TCP_TX_QUEUE_SIZE 2048
+
+// What to do when a client's outbound queue cannot take another frame
+// (selected by the tcpOverflowPolicy user setting)
+#define TCP_OVERFLOW_DROP_OLDEST 0
+#define TCP_OVERFLOW_DROP_NEWEST 1
+#define TCP_OVERFLOW_DISCONNECT 2
+
+// Clients can subscribe to a subset of DE1 frames by tag ("!sub M N", "!unsub M").
+// Tags run from '@' to DEL, one bit each.  Frames without a "[X]" tag are always delivered.
+#define TCP_SUBSCRIBE_ALL 0xFFFFFFFFFFFFFFFFULL
+
+// Clients can also cap the rate of individual tags ("!rate M 2" = at most 2 [M] frames
+// a second).  Within each interval only the newest frame is kept and it goes out when the
+// interval ends, so a slow display always sees the latest sample without falling behind.
+// Frames longer than TCP_RATE_FRAME_SIZE, and tags without a limit, are never held back.
+#define TCP_RATE_MAX_TAGS 4
+#define TCP_RATE_FRAME_SIZE 64
+
+// Clients can pick their own coalescing window ("!coalesce 20" = hold frames up to 20 ms,
+// "!coalesce 20 512" = or until 512 bytes are waiting).  Until they do, or after
+// "!coalesce default", the tcpCoalesceMs/tcpCoalesceBytes settings apply.
+#define TCP_COALESCE_DEFAULT -1
+
+// Keepalive probes catch peers that vanished without closing the connection (a phone
+// that left WiFi): the first goes out after TCP_KEEPALIVE_IDLE_S quiet seconds, then one
+// every TCP_KEEPALIVE_INTERVAL_S, and the connection is dropped after TCP_KEEPALIVE_COUNT
+// go unanswered.
+#define TCP_KEEPALIVE_IDLE_S 30
+#define TCP_KEEPALIVE_INTERVAL_S 10
+#define TCP_KEEPALIVE_COUNT 3
+
+inline uint64_t frameTagBit(const uint8_t *buf, size_t size) {
+  int tag = frameTagIndex(buf, size);
+  return (tag < 0) ? 0 : (1ULL << tag);
+}
+
 class PluckyInterfaceTcpClient : public PluckyInterface {
 public:
   PluckyInterfaceTcpClient() {  
     _readBufIndex = 0;
-    sprintf(_interfaceName, "TCP [no client]");
+    _packed = false;
+    _subscriptions = TCP_SUBSCRIBE_ALL;
+    _numRateLimits = 0;
+    _rateLimitedTags = 0;
+    _rateSkips = 0;
+    _coalesceMs = TCP_COALESCE_DEFAULT;
+    _coalesceBytes = TCP_COALESCE_DEFAULT;
+    _traceId = TRACE_ID_TCP_BASE;
+    _commandLane = DE1_QUEUE_LANE_TCP_BASE;
+    _lastActivity = 0;
+    _resetTxQueue();
+    _setInterfaceName("TCP [no client]");
   };
   ~PluckyInterfaceTcpClient() { };
 
@@ -24,20 +78,99 @@ public:
   bool readAll();
   bool availableForWrite(size_t len=0);
   bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
 
   void setTcpClient(WiFiClient newClient);
+  // Identifies this client's slot in flight recorder traces
+  void setTraceId(uint8_t traceId) { _traceId = traceId; }
+  // This client's lane in the DE1 command queue (a DE1_QUEUE_LANE_*)
+  void setCommandLane(uint8_t lane) { _commandLane = lane; }
 
   bool connected() { return _tcpClient.connected(); }
 
+  // True once the client has asked for packed binary framing (see PluckyFrameCodec.hpp)
+  bool isPacked() { return _packed; }
+  // Queues an already-packed frame, so a fan-out can pack once for all packed clients
+  bool writePacked(const uint8_t *packedFrame, size_t packedSize);
+
+  // tagBit from frameTagBit(); 0 (untagged) is always wanted
+  bool isSubscribed(uint64_t tagBit) { return (tagBit == 0) || (_subscriptions & tagBit); }
+  // True if a "!rate" limit holds the frame back for now (it may be sent later, or be
+  // superseded by a newer one).  The caller must then not write it.
+  bool rateLimited(uint64_t tagBit, const uint8_t *buf, size_t size) {
+    return (_rateLimitedTags & tagBit) && _holdForRateLimit(tagBit, buf, size);
+  }
+
+  const char *getName() { return _interfaceName; }
+  uint16_t getTxQueueDepth() { return _txQueue.used(); }
+  uint16_t getTxQueueHighWater() { return _txHighWater; }
+  uint32_t getTxDrops() { return _txDrops; }
+  uint32_t getTxFrames() { return _txFrames; }
+  uint32_t getTxWrites() { return _txWrites; }
+  uint32_t getRateSkips() { return _rateSkips; }
+  // This client's coalescing window, whether its own or the settings'
+  uint16_t getCoalesceMs();
+  uint16_t getCoalesceBytes();
+  // Time since the client last sent us anything or took anything we sent it
+  unsigned long getIdleMillis() { return millis() - _lastActivity; }
+
   operator bool() {
     return _tcpClient.connected();
   }
  
 protected:
+  void _resetTxQueue();
+  bool _makeTxRoom(size_t size);
+  void _flushTxQueue();
+  bool _txFlushDue();
+  bool _queueFrame(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+  size_t _txHeadFrameSize();
+  void _txSent(const uint8_t *data, size_t sent);
+  uint16_t _readLimit() { return _packed ? READ_BUFFER_SIZE : READ_BUFFER_SIZE - 1; }
+  void _handleFrame(uint8_t *frame, uint16_t len);
+  void _handleControlLine(const char *line);
+  void _setPacked(bool packed);
+  uint64_t _parseTags(const char *tags);
+  void _setRateLimit(uint64_t tags, float hz);
+  void _setCoalesce(const char *args);
+  bool _holdForRateLimit(uint64_t tagBit, const uint8_t *buf, size_t size);
+  void _flushRateLimited();
+  void _setInterfaceName(const char *name);
+  void _enableKeepalive();
+
   WiFiClient _tcpClient;
+  PluckyRingBuffer<TCP_TX_QUEUE_SIZE> _txQueue;
+  bool _txMidFrame;      // last send ended part way through the frame at the head of the queue
+  size_t _txFrameLeft;   // bytes still to send before the head of the queue is at a frame boundary
+  bool _packed;          // client switched to packed framing with "!packed"
+  uint64_t _subscriptions;  // frameTagBit()s of the DE1 frames this client wants
+  struct RateLimit {
+    uint64_t tagBit;
+    unsigned long intervalMs;
+    unsigned long lastSentAt;  // millis()
+    uint8_t pendingLen;        // 0 = nothing held
+    uint8_t pending[TCP_RATE_FRAME_SIZE];
+  };
+  RateLimit _rateLimits[TCP_RATE_MAX_TAGS];
+  uint8_t _numRateLimits;
+  uint64_t _rateLimitedTags; // frameTagBit()s with an entry in _rateLimits
+  uint32_t _rateSkips;       // held frames replaced by a newer one before they were sent
+  int16_t _coalesceMs;       // set by "!coalesce", or TCP_COALESCE_DEFAULT
+  int16_t _coalesceBytes;    // likewise
+  bool _txDropping;      // currently overflowing; used to log once per episode
+  uint16_t _txHighWater;
+  uint32_t _txDrops;
+  unsigned long _txQueuedAt;  // millis() when the oldest unsent frame was queued
+  uint32_t _txFrames;    // frames queued since connect
+  uint32_t _txWrites;    // socket writes those frames went out in
+  unsigned long _lastActivity;  // millis() of the last byte received or sent
   uint8_t _readBuf[READ_BUFFER_SIZE];
   uint16_t _readBufIndex;
   char _interfaceName[32];
+  uint8_t _traceId;
+  uint8_t _commandLane;
+  char _promiscuousPrefix[PROMISCUOUS_PREFIX_SIZE];  // "{_interfaceName} ", kept in step by _setInterfaceName()
+  uint8_t _promiscuousPrefixLen;
 };
 
 
@@ -9,7 +9,22 @@ WiFiServer blah();
 #include "PluckyInterfaceGroup.hpp"
 #include "PluckyInterfaceTcpClient.hpp"
 
+// Upper bound on the tcpMaxClients setting.  Client slots are only allocated when first
+// needed, so slots that are never used cost nothing.
 #define TCP_MAX_CLIENTS 6
+#define TCP_STRINGIFY_(x) #x
+#define TCP_XSTRINGIFY_(x) TCP_STRINGIFY_(x)
+#define TCP_MAX_CLIENTS_STR TCP_XSTRINGIFY_(TCP_MAX_CLIENTS)
+
+// When a new client arrives and every slot is taken, a client with at least this much
+// queued for it is evicted first; otherwise the one idle the longest goes
+#define TCP_EVICT_BACKLOG_BYTES (TCP_TX_QUEUE_SIZE / 2)
+
+// How often to look for idle clients (and clients beyond a lowered limit)
+#define TCP_IDLE_CHECK_MS 1000
+
+// How often to log per-client queue stats, when any client has dropped frames
+#define TCP_STATS_INTERVAL_MS 60000
 
 class PluckyInterfaceTcpPort : public PluckyInterfaceGroup {
 public:
@@ -24,6 +39,22 @@ public:
   bool readAll();
   bool availableForWrite(size_t len=0);
   bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+
+  const char *getName() { return "TCP"; }
+  // Reports the port's own connect/reject counts as "TCP", then each client by slot 
+  // ("TCP_0".."TCP_n"), so labels stay put as clients come and go
+  void visitStats(PluckyStatsVisitor fn, void *ctx);
+
+  // Moves the listening socket to another port.  Clients already connected stay
+  // connected; doLoop() starts listening on the new port on its next pass.
+  void setPort(uint16_t port);
+  uint16_t getPort() { return _tcpPort; }
+
+  uint16_t getClientCount();
+  uint16_t getAllocatedCount();
+  // The tcpMaxClients setting, clamped to 1..TCP_MAX_CLIENTS
+  uint16_t getPoolLimit();
 
   operator bool() {
     for (int i=0; i<TCP_MAX_CLIENTS; i++) {
@@ -35,8 +66,19 @@ public:
   }
 
 protected:
+  void _childName(uint16_t i, char *buf, size_t size);
+  void _reportStats();
+  PluckyInterfaceTcpClient *_client(uint16_t i) { return (PluckyInterfaceTcpClient *)_interfaces[i]; }
+  void _acceptClient();
+  uint16_t _pickEviction(uint16_t limit);
+  void _closeIdleClients();
+  static void _settingsChanged_CB(uint32_t changed, void *ctx);
+
   uint16_t _tcpPort;
   WiFiServer _tcpServer;
+  unsigned long _lastStatsReport;
+  unsigned long _lastIdleCheck;
+  uint32_t _lastReportedDrops;
 };
 
 
@@ -0,0 +1,60 @@
+#ifndef _PLUCKY_INTERFACE_UDP_PUBLISHER_HPP_
+#define _PLUCKY_INTERFACE_UDP_PUBLISHER_HPP_
+
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+#include "PluckyInterface.hpp"
+#include "config.hpp"
+
+// "%08x " in front of every frame
+#define UDP_SEQUENCE_SIZE 9
+
+// How often to pick up changes to the WiFi connection (settings changes apply at once)
+#define UDP_CONFIG_CHECK_MS 1000
+
+// One-way publisher that sends each frame routed to it as a single UDP datagram to a
+// multicast group, the subnet broadcast address or one host (the udpAddress and
+// udpPort settings), so a DE1 frame goes out once however many displays are
+// listening.  Each datagram carries one frame behind a sequence number:
+//   <8 hex digits> <frame>
+// The number goes up by one per datagram (and restarts from 0 with the bridge), so a
+// receiver can count what it missed.  Nothing is ever read back; listeners that want to
+// send commands connect over TCP.  See tools/plucky_udp.py for a listener.
+class PluckyInterfaceUdpPublisher : public PluckyInterface {
+public:
+  PluckyInterfaceUdpPublisher();
+  ~PluckyInterfaceUdpPublisher();
+
+  void doInit();
+  void doLoop();
+
+  void begin();
+  void end();
+  bool available() { return false; }
+  bool readAll() { return false; }
+  bool availableForWrite(size_t len=0) { return _enabled; }
+  bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+
+  const char *getName() { return "UDP"; }
+  // Sequence number the next datagram will carry
+  uint32_t getSequence() { return _sequence; }
+
+  operator bool() { return _enabled; }
+
+protected:
+  void _configure();
+  static void _settingsChanged_CB(uint32_t changed, void *ctx);
+
+  WiFiUDP _udp;
+  IPAddress _address;
+  uint16_t _port;
+  bool _enabled;        // an address is set and WiFi is up
+  bool _wifiConnected;  // as of the last _configure()
+  bool _settingsChanged;  // since the last _configure()
+  uint32_t _sequence;
+  unsigned long _lastConfigCheck;
+};
+
+#endif // _PLUCKY_INTERFACE_UDP_PUBLISHER_HPP_
@@ -0,0 +1,69 @@
+#ifndef _PLUCKY_INTERFACE_WEB_SOCKET_HPP_
+#define _PLUCKY_INTERFACE_WEB_SOCKET_HPP_
+
+#include <WebSocketsServer.h>
+
+#include "PluckyInterface.hpp"
+#include "config.hpp"
+
+// Browser dashboards can't open a raw TCP socket, so the same controller traffic is 
+// also offered as a WebSocket server (ws://<plucky>:81/).  Every DE1 frame is broadcast 
+// to all connected sockets as one text message, without its trailing newline; each 
+// text message received is forwarded to the DE1 as one frame.
+//
+// The synchronous WebServer on port 80 can't hold connections open, hence the 
+// separate server and port.
+#define WEBSOCKET_PORT 81
+
+// The library writes each message with a blocking WiFiClient::write(), so a client whose
+// TCP window has closed would stall the bridge for every other interface.  Messages are
+// only sent to clients whose socket reports room (lwIP: more than TCP_SNDLOWAT bytes of
+// send buffer free, far more than one frame); the rest miss the frame.  A client that
+// has had no room for WEBSOCKET_STALL_TIMEOUT_MS is disconnected.
+#define WEBSOCKET_STALL_TIMEOUT_MS 5000
+
+// WebSocketsServer with access to each client's socket, to check for room before sending
+class PluckyWebSocketsServer : public WebSocketsServer {
+public:
+  PluckyWebSocketsServer(uint16_t port) : WebSocketsServer(port) { }
+
+  // The socket of connected client num, or -1
+  int clientFd(uint8_t num) {
+    WSclient_t *client = &_clients[num];
+    return (client->status == WSC_CONNECTED && client->tcp) ? client->tcp->fd() : -1;
+  }
+};
+
+class PluckyInterfaceWebSocket : public PluckyInterface {
+public:
+  PluckyInterfaceWebSocket(uint16_t port=WEBSOCKET_PORT);
+  ~PluckyInterfaceWebSocket();
+
+  void doInit();
+  void doLoop();
+
+  void begin();
+  void end();
+  bool available();
+  bool readAll();
+  bool availableForWrite(size_t len=0);
+  bool writeAll(const uint8_t *buf, size_t size);
+  bool writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size);
+
+  const char *getName() { return "WebSocket"; }
+
+protected:
+  void _handleEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length);
+  void _handleFrame(uint8_t num, uint8_t *payload, size_t length);
+  void _sendSnapshot(uint8_t num);
+  bool _clientHasRoom(uint8_t num, int fd);
+
+  PluckyWebSocketsServer *_ws;
+  uint16_t _port;
+  uint8_t _readBuf[READ_BUFFER_SIZE];
+  char _promiscuousPrefix[WEBSOCKETS_SERVER_CLIENT_MAX][PROMISCUOUS_PREFIX_SIZE];  // "{WS[ip : port]} "
+  uint8_t _promiscuousPrefixLen[WEBSOCKETS_SERVER_CLIENT_MAX];
+  unsigned long _stalledSince[WEBSOCKETS_SERVER_CLIENT_MAX];  // millis() a client first had no room, or 0
+};
+
+#endif // _PLUCKY_INTERFACE_WEB_SOCKET_HPP_
@@ -0,0 +1,13 @@
+#ifndef _PLUCKY_METRICS_HPP_
+#define _PLUCKY_METRICS_HPP_
+
+#include <Arduino.h>
+
+// Most interfaces the metrics page will list (DE1, USB, BLE, TCP port + slots, WebSocket, ...)
+#define METRICS_MAX_INTERFACES 24
+
+// Writes the per-interface counters of de1Serial and every controller, plus a few
+// system gauges, in the Prometheus text exposition format.
+void printMetrics(Print &out);
+
+#endif // _PLUCKY_METRICS_HPP_
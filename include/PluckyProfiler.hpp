@@ -0,0 +1,68 @@
+#ifndef _PLUCKY_PROFILER_HPP_
+#define _PLUCKY_PROFILER_HPP_
+
+#include <Arduino.h>
+
+#include "config.hpp"
+
+// Latency histograms for the phases of loop() and for each interface's doLoop(),
+// timed with the CPU cycle counter and served at /profile.
+//
+// Buckets are logarithmic with two per power of two (e.g. 64-95, 96-127, 128-191 ...
+// cycles), so percentiles are accurate to within about 25% while recording costs a
+// count-leading-zeros and a couple of increments.
+#define PROFILER_NUM_BUCKETS 64
+#define PROFILER_MAX_HISTOGRAMS 24
+#define PROFILER_NAME_SIZE 24
+
+class PluckyLatencyHistogram {
+public:
+  PluckyLatencyHistogram() { reset(); }
+
+  void reset();
+  inline void record(uint32_t cycles) {
+#if ENABLE_LOOP_PROFILER
+    _count++;
+    if (cycles > _max) {
+      _max = cycles;
+    }
+    _buckets[_bucketFor(cycles)]++;
+#endif // ENABLE_LOOP_PROFILER
+  }
+
+  uint32_t count() const { return _count; }
+  uint32_t max() const { return _max; }
+  // Upper bound, in cycles, of the bucket holding the p'th fraction of samples (0..1)
+  uint32_t percentile(float p) const;
+
+protected:
+  static inline uint8_t _bucketFor(uint32_t cycles) {
+    if (cycles < 2) {
+      return cycles;
+    }
+    uint8_t msb = 31 - __builtin_clz(cycles);
+    return (msb << 1) | ((cycles >> (msb - 1)) & 1);
+  }
+  static uint32_t _bucketUpperBound(uint8_t bucket);
+
+  uint32_t _buckets[PROFILER_NUM_BUCKETS];
+  uint32_t _count;
+  uint32_t _max;
+};
+
+// Current cycle count, or 0 when the profiler is compiled out
+inline uint32_t profilerNow() {
+#if ENABLE_LOOP_PROFILER
+  return ESP.getCycleCount();
+#else
+  return 0;
+#endif // ENABLE_LOOP_PROFILER
+}
+
+// Adds a histogram to the /profile report.  The name is copied.
+void profilerRegister(const char *name, PluckyLatencyHistogram *histogram);
+// One line per histogram: name, count, p50/p99/max in microseconds
+void profilerPrint(Print &out);
+void profilerReset();
+
+#endif // _PLUCKY_PROFILER_HPP_
@@ -0,0 +1,121 @@
+#ifndef _PLUCKY_RING_BUFFER_HPP_
+#define _PLUCKY_RING_BUFFER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Fixed-size byte FIFO with inline storage.
+//
+// Producers that can write in bulk (e.g. a UART driver read) ask for the
+// contiguous free span with writeSpan(), fill it, then commit() what they wrote.
+// Consumers do the same with readSpan()/consume(), or copy out with pop().
+// Not thread-safe; each instance is owned by a single interface.
+template <size_t N>
+class PluckyRingBuffer {
+public:
+  PluckyRingBuffer() { clear(); }
+
+  void clear() { _head = 0; _used = 0; }
+
+  size_t size() const { return N; }
+  size_t used() const { return _used; }
+  size_t available() const { return N - _used; }
+  bool empty() const { return _used == 0; }
+  bool full() const { return _used == N; }
+
+  // Contiguous free region starting at the write position.
+  size_t writeSpan(uint8_t **ptr) {
+    size_t tail = _wrap(_head + _used);
+    *ptr = &_buf[tail];
+    if (_used == N) {
+      return 0;
+    }
+    return (tail >= _head) ? (N - tail) : (_head - tail);
+  }
+
+  void commit(size_t len) { _used += len; }
+
+  // Contiguous readable region starting at the read position.
+  size_t readSpan(const uint8_t **ptr) const {
+    *ptr = &_buf[_head];
+    return (_head + _used <= N) ? _used : (N - _head);
+  }
+
+  void consume(size_t len) {
+    if (len > _used) {
+      len = _used;
+    }
+    _head = _wrap(_head + len);
+    _used -= len;
+  }
+
+  // Copies in as much of buf as fits, returning the number of bytes queued.
+  size_t push(const uint8_t *buf, size_t len) {
+    size_t pushed = 0;
+    while (pushed < len) {
+      uint8_t *dst;
+      size_t span = writeSpan(&dst);
+      if (span == 0) {
+        break;
+      }
+      if (span > len - pushed) {
+        span = len - pushed;
+      }
+      memcpy(dst, buf + pushed, span);
+      commit(span);
+      pushed += span;
+    }
+    return pushed;
+  }
+
+  // Copies out (without consuming) up to len bytes from the read position.
+  size_t peek(uint8_t *dst, size_t len) const {
+    if (len > _used) {
+      len = _used;
+    }
+    size_t first = N - _head;
+    if (first > len) {
+      first = len;
+    }
+    memcpy(dst, &_buf[_head], first);
+    memcpy(dst + first, &_buf[0], len - first);
+    return len;
+  }
+
+  size_t pop(uint8_t *dst, size_t len) {
+    len = peek(dst, len);
+    consume(len);
+    return len;
+  }
+
+  // Offset of the first occurrence of c within the first `limit` queued
+  // bytes, or -1 if there is none.
+  int find(uint8_t c, size_t limit) const {
+    if (limit > _used) {
+      limit = _used;
+    }
+    size_t first = N - _head;
+    if (first > limit) {
+      first = limit;
+    }
+    const uint8_t *hit = (const uint8_t *)memchr(&_buf[_head], c, first);
+    if (hit) {
+      return hit - &_buf[_head];
+    }
+    hit = (const uint8_t *)memchr(&_buf[0], c, limit - first);
+    if (hit) {
+      return first + (hit - &_buf[0]);
+    }
+    return -1;
+  }
+
+private:
+  size_t _wrap(size_t i) const { return (i >= N) ? (i - N) : i; }
+
+  uint8_t _buf[N];
+  size_t _head;
+  size_t _used;
+};
+
+#endif // _PLUCKY_RING_BUFFER_HPP_
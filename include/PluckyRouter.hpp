@@ -0,0 +1,72 @@
+#ifndef _PLUCKY_ROUTER_HPP_
+#define _PLUCKY_ROUTER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "PluckyInterface.hpp"
+
+// Routing endpoints.  Each is one interface (TCP and WebSocket being the whole
+// port/server, i.e. every connected client).  UDP is send-only.
+#define ROUTE_DE1 0
+#define ROUTE_USB 1
+#define ROUTE_BLE 2
+#define ROUTE_TCP 3
+#define ROUTE_WEBSOCKET 4
+#define ROUTE_UDP 5
+#define ROUTE_NUM_ENDPOINTS 6
+
+#define ROUTE_BIT(id) ((uint8_t)(1 << (id)))
+#define ROUTE_CONTROLLERS (ROUTE_BIT(ROUTE_USB) | ROUTE_BIT(ROUTE_BLE) | ROUTE_BIT(ROUTE_TCP) | \
+                           ROUTE_BIT(ROUTE_WEBSOCKET) | ROUTE_BIT(ROUTE_UDP))
+
+// Table-driven frame routing.  For each source endpoint the table holds two
+// destination bitmasks: frames forwarded as is, and frames forwarded with the
+// source's "{interface} " prefix (promiscuous mode).  The table is rebuilt from the
+// user settings at startup and whenever the config is saved, so dispatching a frame
+// is just a walk over the set bits.
+//
+// The default table sends DE1 frames to every controller and controller frames to 
+// the DE1 (plus, prefixed, to every controller when promiscuous mode is on).  
+// The routes setting adds or removes routes on top of that, as space separated 
+// "SRC>DST" or "!SRC>DST" terms over the names DE1, USB, BLE, TCP, WS and UDP, e.g.
+//   "BLE>TCP TCP>BLE"   mirror BLE and TCP traffic to each other
+//   "!DE1>BLE !DE1>TCP !DE1>WS"   only USB sees the DE1 (a monitor tap)
+//
+// Rebuilding writes each mask as a single byte, so a bridge task dispatching 
+// concurrently sees either the old or the new route, never a mix.
+class PluckyRouter {
+public:
+  PluckyRouter();
+
+  // Registers the interface frames for endpoint id are written to
+  void attach(uint8_t id, PluckyInterface *iface);
+
+  // Recomputes the table from the promiscuous and routes settings
+  void rebuild();
+  // PluckySettingsListener for those two settings; ctx is the router
+  static void settingsChanged_CB(uint32_t changed, void *ctx) { ((PluckyRouter *)ctx)->rebuild(); }
+
+  // Writes buf to every destination routed from source; prefixed routes get prefix + buf.
+  // sender (a DE1_QUEUE_LANE_*) says whose turn the frame takes on destinations that
+  // share their output fairly, i.e. the DE1.
+  void dispatch(uint8_t source, uint8_t sender, const uint8_t *prefix, size_t prefixLen, const uint8_t *buf, size_t len);
+
+  uint8_t getRoutes(uint8_t source) { return _routes[source]; }
+  uint8_t getPrefixedRoutes(uint8_t source) { return _prefixedRoutes[source]; }
+
+  PluckyInterface *getEndpoint(uint8_t id) { return _endpoints[id]; }
+
+  static const char *endpointName(uint8_t id);
+  // Endpoint id for a name such as "BLE" (case-insensitive), or -1
+  static int endpointId(const char *name, size_t len);
+
+protected:
+  PluckyInterface *_endpoints[ROUTE_NUM_ENDPOINTS];
+  volatile uint8_t _routes[ROUTE_NUM_ENDPOINTS];
+  volatile uint8_t _prefixedRoutes[ROUTE_NUM_ENDPOINTS];
+
+  static void _applyRoutes(const char *spec, uint8_t *routes);
+};
+
+#endif // _PLUCKY_ROUTER_HPP_
@@ -0,0 +1,74 @@
+#ifndef _PLUCKY_SETTINGS_HPP_
+#define _PLUCKY_SETTINGS_HPP_
+
+#include <stdint.h>
+
+#include "config.hpp"
+
+// One bit per setting, for reload()'s result and subscribe()'s mask
+#define SETTING_PROMISCUOUS         (1UL << 0)
+#define SETTING_ROUTES              (1UL << 1)
+#define SETTING_BLE_FLOW_CONTROL    (1UL << 2)
+#define SETTING_TCP_PORT            (1UL << 3)
+#define SETTING_TCP_OVERFLOW_POLICY (1UL << 4)
+#define SETTING_TCP_COALESCE_MS     (1UL << 5)
+#define SETTING_TCP_COALESCE_BYTES  (1UL << 6)
+#define SETTING_TCP_MAX_CLIENTS     (1UL << 7)
+#define SETTING_TCP_IDLE_TIMEOUT    (1UL << 8)
+#define SETTING_UDP_ADDRESS         (1UL << 9)
+#define SETTING_UDP_PORT            (1UL << 10)
+#define SETTING_NUM_SETTINGS 11
+
+#define SETTINGS_MAX_SUBSCRIBERS 8
+
+// Called with the bits of the settings that changed (only ever ones in the subscribed mask)
+typedef void (*PluckySettingsListener)(uint32_t changed, void *ctx);
+
+// The userSettingStr_* strings, parsed into native values.  IotWebConf keeps reading
+// and writing the strings; reload() turns them into the fields below once at startup
+// and again each time the config is saved, so nothing on the frame path parses text.
+// Values out of range are clamped, and ones that aren't numbers fall back to the
+// default, with a warning either way.
+//
+// Interfaces that have to act on a change (the TCP port rebinding, the BLE UART
+// switching flow control) subscribe() to it and are called from reload(), so a new
+// value takes effect without a reboot.  Everything else just reads the fields.
+// reload() and the listeners run on loop(); the fields are single words, so the
+// bridge task reading one concurrently sees either the old or the new value.
+class PluckySettings {
+public:
+  PluckySettings();
+
+  bool promiscuous;
+  bool bleFlowControl;
+  uint16_t tcpPort;
+  uint8_t tcpOverflowPolicy;        // TCP_OVERFLOW_*
+  uint16_t tcpCoalesceMs;
+  uint16_t tcpCoalesceBytes;
+  uint8_t tcpMaxClients;            // 1..TCP_MAX_CLIENTS
+  uint32_t tcpIdleTimeoutMs;        // 0 = never
+  uint16_t udpPort;
+  char routes[USER_SETTING_ROUTES_STR_LEN];
+  char udpAddress[USER_SETTING_ADDRESS_STR_LEN];
+
+  // Re-parses the setting strings and notifies the subscribers of whatever changed.
+  // Returns the SETTING_* bits that changed (all of them the first time).
+  uint32_t reload();
+
+  // Calls fn(changed, ctx) from reload() whenever a setting in mask changes
+  bool subscribe(uint32_t mask, PluckySettingsListener fn, void *ctx);
+  void unsubscribe(void *ctx);
+
+protected:
+  struct Subscriber {
+    uint32_t mask;
+    PluckySettingsListener fn;
+    void *ctx;
+  };
+
+  Subscriber _subscribers[SETTINGS_MAX_SUBSCRIBERS];
+  uint8_t _numSubscribers;
+  bool _loaded;
+};
+
+#endif // _PLUCKY_SETTINGS_HPP_
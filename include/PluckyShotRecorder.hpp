@@ -0,0 +1,110 @@
+#ifndef _PLUCKY_SHOT_RECORDER_HPP_
+#define _PLUCKY_SHOT_RECORDER_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Captures each espresso shot the DE1 pulls: every frame it sends from the moment it
+// enters the Espresso state until it leaves it, preceded by the latest frame of every
+// other type (water level, shot settings, ...) so a recording stands on its own.
+//
+// record() runs on the DE1 read path, so all it does is pack the frame (see
+// PluckyFrameCodec) and copy it into a RAM staging ring; it never touches flash.  The
+// shot store's writer task (PluckyShotStore.hpp) drains the ring with take(), a whole
+// SHOT_WRITE_CHUNK at a time, into one SPIFFS file per shot.  Producer and consumer
+// share nothing but the ring's two positions, so they may run on different cores.  If
+// the writer falls so far behind that the ring fills, frames are dropped (and counted)
+// rather than the DE1 path waiting.
+//
+// Recording layout (little-endian):
+//   header:  magic "PLKS", version u16, header size u16, shot number u32,
+//            millis() at the start u32
+//   records: ms since the previous record u16, then the frame packed as
+//            len | kind | tag | data (PluckyFrameCodec.hpp)
+//   trailer: SHOT_TRAILER_MARK u16, frames u32, dropped frames u32, duration ms u32
+// Decode with tools/plucky_shot.py.
+
+#define DE1_STATE_ESPRESSO 4
+
+#define SHOT_STAGING_SIZE 16384    // power of two; about 60 s of shot at 10 frames/s
+#define SHOT_WRITE_CHUNK 1024      // multiple of the 256-byte SPIFFS page
+#define SHOT_MAX_PENDING_ENDS 4    // power of two; shots staged but not yet fully written
+// How full the ring may get before writeDue() stops waiting for the end of the shot
+#define SHOT_DEFER_LIMIT (SHOT_STAGING_SIZE - 4 * SHOT_WRITE_CHUNK)
+#define SHOT_MAX_DURATION_MS 600000UL  // end a recording that runs this long regardless
+
+#define SHOT_MAGIC 0x534b4c50  // "PLKS"
+#define SHOT_VERSION 1
+#define SHOT_TRAILER_MARK 0xFFFF
+#define SHOT_MAX_DELTA_MS 0xFFFE
+
+struct __attribute__((packed)) PluckyShotHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t headerSize;
+  uint32_t shotNumber;
+  uint32_t startMs;
+};
+
+struct __attribute__((packed)) PluckyShotTrailer {
+  uint16_t mark;          // SHOT_TRAILER_MARK
+  uint32_t numFrames;
+  uint32_t droppedFrames; // didn't fit in the staging ring
+  uint32_t durationMs;
+};
+
+class PluckyShotRecorder {
+public:
+  PluckyShotRecorder();
+
+  // Producer side: every frame from the DE1, from whoever reads its UART
+  void record(const uint8_t *buf, size_t len);
+
+  // Consumer side.  True when take() has a full chunk, or the end of a shot, to give
+  bool chunkReady();
+  // True when a staged shot has ended, or the ring has passed SHOT_DEFER_LIMIT.  For a
+  // writer that would rather leave a shot in RAM while it is being pulled.
+  bool writeDue();
+  // Moves up to max staged bytes into out, never past the end of a shot.  Sets
+  // *endOfShot when those bytes finish one.  Each shot's bytes start with its header.
+  size_t take(uint8_t *out, size_t max, bool *endOfShot);
+
+  // Number the next shot will get (the store continues from what is on flash)
+  void setNextShotNumber(uint32_t n) { _nextShot.store(n, std::memory_order_relaxed); }
+
+  bool recording() { return _recording; }
+  size_t staged() { return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire); }
+  uint32_t getShots() { return _shots; }
+  uint32_t getFrames() { return _totalFrames; }
+  uint32_t getDrops() { return _totalDrops; }
+  uint32_t getSkippedShots() { return _skippedShots; }
+
+protected:
+  void _begin(uint32_t now);
+  void _end(uint32_t now);
+  bool _stage(uint32_t now, const uint8_t *frame, size_t len);
+  bool _push(const void *data, size_t len, size_t reserve);
+
+  uint8_t _ring[SHOT_STAGING_SIZE];
+  std::atomic<uint32_t> _head;  // next byte to take; written only by the consumer
+  std::atomic<uint32_t> _tail;  // next byte to fill; written only by the producer
+  uint32_t _ends[SHOT_MAX_PENDING_ENDS];  // ring positions where staged shots end
+  std::atomic<uint32_t> _endHead;
+  std::atomic<uint32_t> _endTail;
+  std::atomic<uint32_t> _nextShot;
+
+  // Producer-only state of the shot being recorded
+  bool _recording;
+  uint32_t _startMs;
+  uint32_t _lastMs;
+  uint32_t _frames;
+  uint32_t _drops;
+
+  uint32_t _shots;
+  uint32_t _totalFrames;
+  uint32_t _totalDrops;
+  uint32_t _skippedShots;
+};
+
+#endif // _PLUCKY_SHOT_RECORDER_HPP_
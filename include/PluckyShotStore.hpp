@@ -0,0 +1,45 @@
+#ifndef _PLUCKY_SHOT_STORE_HPP_
+#define _PLUCKY_SHOT_STORE_HPP_
+
+#include <Arduino.h>
+
+#include "PluckyShotRecorder.hpp"
+
+// Shot recordings on flash, one SPIFFS file per shot, listed at /shots and downloaded
+// from /shot?n=<number>.
+//
+// A low-priority writer task on loop()'s core moves what PluckyShotRecorder staged to
+// flash, in writes of exactly SHOT_WRITE_CHUNK bytes (the last one of a shot aside), so
+// the file grows a few whole pages at a time rather than by one small append per frame.
+//
+// A flash write, and any sector erase SPIFFS does for it, suspends everything running
+// from flash on both cores, the bridge task and the UART interrupt handlers (not in IRAM)
+// included.  Meanwhile received bytes can only collect in each UART's 128-byte hardware
+// FIFO, about 11 ms worth at 115200 baud.  How long these writes take on the board has
+// not been measured (each saved shot logs its longest), so the writer keeps them away
+// from the shot: it waits until the shot has ended before writing it (writeDue()),
+// unless the staging ring fills past SHOT_DEFER_LIMIT first.
+//
+// Before each new shot the oldest recordings are deleted until there are fewer than
+// SHOT_MAX_FILES and at least SHOT_MIN_FREE_BYTES of SPIFFS is free.
+
+#define SHOT_FILE_FORMAT "/shot%05u.plk"
+#define SHOT_MAX_FILES 20
+#define SHOT_MIN_FREE_BYTES 65536
+
+#define SHOT_WRITER_PERIOD_MS 100
+#define SHOT_WRITER_TASK_CORE 1        // loop()'s core, away from the bridge task
+#define SHOT_WRITER_TASK_PRIORITY 1    // same as loop(); flash work never preempts it
+#define SHOT_WRITER_TASK_STACK_SIZE 4096
+
+// Continues the shot numbering from the recordings already on flash and starts the
+// writer task.  SPIFFS must be mounted.
+void shotStoreBegin();
+
+// One line per recording, oldest first: shot number, size, frames, drops, duration
+void shotStorePrintList(Print &out);
+
+// SPIFFS path of recording n in path; false if there is no such recording
+bool shotStorePath(uint32_t n, char *path, size_t size);
+
+#endif // _PLUCKY_SHOT_STORE_HPP_
@@ -0,0 +1,76 @@
+#ifndef _PLUCKY_SPSC_QUEUE_HPP_
+#define _PLUCKY_SPSC_QUEUE_HPP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// Lock-free single-producer / single-consumer queue of frames, used to pass
+// messages between the bridge task and loop() when they run on different cores.
+//
+// Exactly one task may call push() and exactly one (other) task may call
+// front()/pop().  Each slot holds one frame of up to SLOT_SIZE bytes; the
+// producer copies in, the consumer reads in place and then pops.
+template <size_t DEPTH, size_t SLOT_SIZE>
+class PluckySpscQueue {
+  static_assert((DEPTH & (DEPTH - 1)) == 0, "DEPTH must be a power of two");
+
+public:
+  PluckySpscQueue() : _head(0), _tail(0) { }
+
+  // Producer side.  Returns false (and queues nothing) if full or if the frame is too long.
+  bool push(const uint8_t *buf, size_t len) {
+    return push(NULL, 0, buf, len);
+  }
+
+  // Queues prefix + buf as a single frame
+  bool push(const uint8_t *prefix, size_t prefixLen, const uint8_t *buf, size_t len) {
+    if (prefixLen + len > SLOT_SIZE) {
+      return false;
+    }
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) >= DEPTH) {
+      return false;
+    }
+    Slot &slot = _slots[tail % DEPTH];
+    if (prefixLen) {
+      memcpy(slot.data, prefix, prefixLen);
+    }
+    memcpy(slot.data + prefixLen, buf, len);
+    slot.len = prefixLen + len;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side.  Returns the oldest frame (valid until pop()), or NULL if empty.
+  const uint8_t *front(size_t *len) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    Slot &slot = _slots[head % DEPTH];
+    *len = slot.len;
+    return slot.data;
+  }
+
+  void pop() {
+    _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  bool empty() const {
+    return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Slot {
+    uint16_t len;
+    uint8_t data[SLOT_SIZE];
+  };
+
+  Slot _slots[DEPTH];
+  std::atomic<uint32_t> _head;  // next slot to consume; written only by the consumer
+  std::atomic<uint32_t> _tail;  // next slot to fill; written only by the producer
+};
+
+#endif // _PLUCKY_SPSC_QUEUE_HPP_
@@ -24,6 +24,7 @@ public:
   // handlers
   static void handleConfig_CB();
   static void wifiConnectedHandler_CB();
+  static void configSavedHandler_CB();
   static void handleNotFound_CB();
   
 protected:
@@ -9,11 +9,26 @@ class PluckyWebServer;
 
 #include "PluckyWebConfig.hpp"
 
+// Static assets are indexed once at startup from the manifest written by
+// tools/build_data.py, so a request costs one lookup instead of several SPIFFS probes.
+#define WEB_MANIFEST_PATH "/manifest.txt"
+#define WEB_MAX_ASSETS 32
+#define WEB_ASSET_MAX_AGE "86400"  // seconds browsers may reuse css/images before revalidating
+
+struct PluckyWebAsset {
+  String path;  // URL path, e.g. "/b/css/bootstrap.min.css"
+  String etag;  // quoted, or empty if unknown
+  bool gzipped; // stored in SPIFFS as path + ".gz"
+};
+
 class PluckyWebServer {
 public:
   PluckyWebServer(int port=80);
   ~PluckyWebServer();
 
+  // Reads the saved settings (IotWebConf's EEPROM config).  Needs neither SPIFFS nor WiFi,
+  // so it can run before the UARTs are opened; doInit() must follow.
+  void loadSettings();
   void doInit();
   void doLoop();
 
@@ -21,14 +36,28 @@ public:
   static void handleNotFound_CB();
   static void handleWake_CB();
   static void handleSleep_CB();
+  static void handleDe1State_CB();
+  static void handleMetrics_CB();
+  static void handleProfile_CB();
+  static void handleTrace_CB();
+  static void handleShots_CB();
+  static void handleShot_CB();
+  static void handleBoot_CB();
+  static void handleFilters_CB();
+  static void handleFiltersUpdate_CB();
 
 protected:
   WebServer *_ws;
   PluckyWebConfig *_webConfig;
+  PluckyWebAsset _assets[WEB_MAX_ASSETS];
+  int _numAssets;
 
   // Helper functions
   String _getContentType(String filename);
-  bool _webPathExists(String path);
+  void _loadAssetIndex();
+  void _indexSpiffs();
+  const PluckyWebAsset *_findAsset(const String &path);
+  void _loadFilters();
 
   // Handlers
   bool _handleFileRead(String path);
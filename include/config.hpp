@@ -8,7 +8,8 @@
 // These string variables are being assigned DEFAULT values defined here, when they are declared.  
 // These values  can/will get overridden if the user changes them via WebConfig.
 //  - To change the defaults, edit the #defines in this file
-//  - To use the values, read the global strings 
+//  - To use the values, read the parsed copies in userSettings (see PluckySettings.hpp),
+//    which are refreshed, and their subscribers told, whenever the config is saved
 //  
 // Doing it this way has the nice property of both working via the webconfig UI but also
 // working cleanly if e.g. someone wants to disable web altogether, including the webconfig.
@@ -16,10 +17,17 @@
 //
 
 #define USER_SETTING_INT_STR_LEN 8
+#define USER_SETTING_ROUTES_STR_LEN 64
+#define USER_SETTING_ADDRESS_STR_LEN 16
 
 /***********************  General Config *******************/
 #define DEFAULT_PROMISCUOUS "0"
 
+// Extra routes on top of the default DE1 <-> controllers routing, as space separated
+// "SRC>DST" (add) or "!SRC>DST" (remove) terms over DE1, USB, BLE, TCP, WS and UDP.
+// See PluckyRouter.hpp.  e.g. "BLE>TCP TCP>BLE" mirrors BLE and TCP traffic.
+#define DEFAULT_ROUTES ""
+
 /*************************  Serial Config *******************************/
 
 // 1 = enable flow control by default [recommended]
@@ -36,6 +44,34 @@
 /*************************  TCP Config *******************************/
 #define DEFAULT_TCP_PORT "9090"
 
+// What to do when a TCP client can't keep up and its outbound queue is full:
+// 0 = drop the oldest queued frames [recommended; clients see the freshest data]
+// 1 = drop the newest frame
+// 2 = disconnect the client
+#define DEFAULT_TCP_OVERFLOW_POLICY "0"
+
+// Frame coalescing: hold outgoing frames for up to this many ms per TCP client and send 
+// whatever has accumulated in one write, trading a little latency for far fewer, fuller
+// packets when several clients are connected.  5-20 ms is a sensible range during a shot.
+// 0 = send every frame as soon as it arrives [default]
+#define DEFAULT_TCP_COALESCE_MS "0"
+// ...but send early once this many bytes are waiting (roughly one TCP segment)
+#define DEFAULT_TCP_COALESCE_BYTES "1024"
+
+// Most TCP clients connected at once, up to TCP_MAX_CLIENTS.  When all are taken a new 
+// client still gets in: the most backlogged client, or else the one quiet the longest, 
+// is disconnected to make room.
+#define DEFAULT_TCP_MAX_CLIENTS "6"
+// Disconnect a TCP client that has neither sent anything nor taken anything we sent it 
+// for this many seconds.  0 = never.
+#define DEFAULT_TCP_IDLE_TIMEOUT_S "3600"
+
+/*************************  UDP Config *******************************/
+// Where to publish DE1 frames over UDP: a multicast group (e.g. "239.72.68.49"), 
+// "broadcast" for the local subnet, or a single host's address.  "" = off [default]
+#define DEFAULT_UDP_ADDRESS ""
+#define DEFAULT_UDP_PORT "9091"
+
 /*************************  WebConfig Config *******************************/
 #define WIFI_DEFAULT_PASSWORD "decentDE1"
 
@@ -53,6 +89,64 @@
 // Then let's just double that, as it doesn't amount to much and we are not tight on memory at the moment.  
 #define READ_BUFFER_SIZE 128
 
+// Frames each sender (USB, BLE, WebSocket, each TCP client) may have waiting for room in 
+// the DE1 UART's TX buffer before further ones are dropped.  Must be a power of two.
+#define DE1_COMMAND_QUEUE_DEPTH 8
+
+// 1 = time each phase of loop() and each interface's doLoop() with the CPU cycle counter,
+//     into histograms served at /profile [default; costs well under a microsecond per loop]
+// 0 = compile the profiler out
+#define ENABLE_LOOP_PROFILER 1
+
+/*************************  Dual-Core Bridge  *******************************/
+// 1 = service the DE1, BLE and USB UARTs from a dedicated FreeRTOS task pinned to 
+//     BRIDGE_TASK_CORE, so that slow web / WiFi work in loop() can't delay DE1<->BLE traffic.
+//     TCP and web stay in loop() on the other core; see PluckyBridgeTask.hpp
+// 0 = everything runs from loop() [default]
+#define ENABLE_DUAL_CORE_BRIDGE 0
+
+// loop() runs on core 1.  The WiFi / lwIP tasks live on core 0 but are mostly 
+// blocked, which leaves core 0 room for the bridge.
+#define BRIDGE_TASK_CORE 0
+// Above loopTask (1), below the WiFi (23) and lwIP (18) tasks it shares core 0 with
+#define BRIDGE_TASK_PRIORITY 10
+#define BRIDGE_TASK_STACK_SIZE 4096
+
+// 1 = the bridge task sleeps until HardwareSerial's onReceive callback says a UART has
+//     data (its RX FIFO threshold, or the RX idle timeout at the end of a frame)
+// 0 = the bridge task polls its UARTs once per FreeRTOS tick [default]
+// Not yet measured against polling on hardware; see "Dual-core bridge" in the README.
+// Requires ENABLE_DUAL_CORE_BRIDGE and arduino-esp32 2.0.3 or later (HardwareSerial::onReceive)
+#define ENABLE_UART_EVENT_RX 0
+
+// Frames that can be in flight between the bridge task and loop(), per interface 
+// and direction.  Must be a power of two.
+#define BRIDGE_QUEUE_DEPTH 16
+// Room for a promiscuous "{interface} " prefix on top of a full read buffer
+#define BRIDGE_FRAME_SIZE (READ_BUFFER_SIZE + 40)
+
+#if ENABLE_UART_EVENT_RX && !ENABLE_DUAL_CORE_BRIDGE
+#error "ENABLE_UART_EVENT_RX requires ENABLE_DUAL_CORE_BRIDGE"
+#endif
+
+/*************************  DE1 Simulator  *******************************/
+// 1 = no DE1 on the UART: PluckyInterfaceDe1Sim stands in for it, answering <B> state
+//     requests and replaying a shot whenever Espresso is requested, for load testing
+//     the bridge and the web side on the bench.  The DE1 UART is left untouched.
+// 0 = the real DE1 [default]
+#define ENABLE_DE1_SIMULATOR 0
+
+// The shot the simulator replays: a recording downloaded from /shot?n=, put in data/
+// so that uploadfs copies it over.  Without one it plays a built-in synthetic shot.
+#define DE1_SIM_SHOT_PATH "/de1sim.plk"
+// 1 = the recorded timing, N = N times faster, 0 = as fast as the bridge loop runs
+#define DE1_SIM_SPEED 1
+// 1 = replay the shot over and over until something else is requested
+#define DE1_SIM_REPEAT 0
+// 1 = simulated shots are recorded to flash (see /shots) like real ones
+// 0 = only the real machine's shots are recorded [default]
+#define DE1_SIM_RECORD_SHOTS 0
+
 /*************************  BLE P05 Handshake Workaround  *******************************/
 // The OOB message {F}00000001 is sent from the BLE adaptor to the DE1 
 // during connection startup, which enables a secondary flow control mechanism between the 
@@ -86,7 +180,7 @@
 #define ENABLE_REMOTE_OOB 1
 
 // When this changes, the config portal forces a reconfig
-#define CONFIG_VERSION "plucky-0.04"
+#define CONFIG_VERSION "plucky-0.09"
 
 
 #endif // _PLUCKY_CONFIG_HPP_
\ No newline at end of file
@@ -0,0 +1,733 @@
+// Host-native benchmark of the Plucky routing core.
+//
+// Builds the same interface topology as main.cpp (DE1 UART, USB + BLE UARTs and
+// the TCP port) on top of the in-memory fakes in native/, pushes DE1 and
+// controller frames through readAll() -> writeAll() and reports frames/sec,
+// bytes/sec and per-frame latency for each direction.
+//
+//   pio run -e native && .pio/build/native/program [-n frames] [-c tcp_clients] [-m] [-p] [-t file] [-r shot]
+//
+// Also a WebSocket server with one client that stops reading.
+//
+// -m dumps the /metrics page afterwards, -p the /profile page, and -t saves the
+// flight recorder as /trace would serve it (decode with tools/plucky_trace.py).
+// -r has the DE1 simulator replay a shot recording (from /shot?n=) instead of its
+// built-in shot.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include <ArduinoSimpleLogging.h>
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+#include "PluckyInterfaceSerial.hpp"
+#include "PluckyInterfaceDe1Sim.hpp"
+#include "PluckyInterfaceGroup.hpp"
+#include "PluckyInterfaceTcpPort.hpp"
+#include "PluckyInterfaceUdpPublisher.hpp"
+#include "PluckyInterfaceWebSocket.hpp"
+#include "PluckyFrameCodec.hpp"
+#include "PluckyDe1State.hpp"
+#include "PluckyMetrics.hpp"
+#include "PluckyProfiler.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyRouter.hpp"
+#include "PluckyFilter.hpp"
+#include "PluckySettings.hpp"
+#include "PluckyShotRecorder.hpp"
+#include "config.hpp"
+
+// Globals normally provided by main.cpp
+char *userSettingStr_bleFlowControl;
+char *userSettingStr_tcpPort;
+char *userSettingStr_promiscuous;
+char *userSettingStr_routes;
+char *userSettingStr_tcpOverflowPolicy;
+char *userSettingStr_tcpCoalesceMs;
+char *userSettingStr_tcpCoalesceBytes;
+char *userSettingStr_tcpMaxClients;
+char *userSettingStr_tcpIdleTimeoutS;
+char *userSettingStr_udpAddress;
+char *userSettingStr_udpPort;
+PluckySettings userSettings;
+
+PluckyInterfaceSerial de1Serial(SERIAL_DE_UART_NUM);
+PluckyInterfaceDe1Sim de1Sim;
+PluckyInterface *de1 = &de1Serial;
+PluckyDe1State de1State;
+PluckyFlightRecorder flightRecorder;
+PluckyShotRecorder shotRecorder;
+PluckyRouter router;
+PluckyFilter frameFilter;
+
+#define NUM_CONTROLLERS 4
+PluckyInterfaceGroup controllers(NUM_CONTROLLERS);
+PluckyInterfaceTcpPort *tcpPort;
+
+bool de1Initialized = false;
+
+// Representative traffic: shot samples and state updates from the DE1,
+// subscriptions and commands from the controllers.
+static const char *de1Frames[] = {
+  "[M]2C1A0F3A1C2B0A5D05DC0A000B2C3A2B19001E\n",
+  "[M]2C1B0F381C2A0A6105DC0A000B2C3A2B19001F\n",
+  "[N]0404\n",
+  "[M]2C1C0F371C2A0A6405DC0A000B2C3A2B190020\n",
+  "[Q]0A32001E02\n",
+};
+static const char *controllerFrames[] = {
+  "<+M>\n",
+  "[B]02\n",
+  "<+N>\n",
+  "[B]04\n",
+};
+#define NUM_DE1_FRAMES (sizeof(de1Frames) / sizeof(de1Frames[0]))
+#define NUM_CONTROLLER_FRAMES (sizeof(controllerFrames) / sizeof(controllerFrames[0]))
+
+static std::vector<std::shared_ptr<FakeSocket> > tcpPeers;
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct BenchResult {
+  uint32_t frames;
+  uint64_t bytes;
+  double seconds;
+  uint64_t delivered;
+  std::vector<uint32_t> latencyNs;
+};
+
+// A scenario injects one frame at the source, runs the source interface's
+// readAll() and counts what arrived at the destination(s).
+struct Scenario {
+  const char *name;
+  const char **frames;
+  size_t numFrames;
+  void (*inject)(const char *frame);
+  bool (*readAll)();
+  uint64_t (*delivered)();
+};
+
+static HardwareSerial *uart(int uart_nr) {
+  return HardwareSerial::fakeForUart(uart_nr);
+}
+
+static uint64_t controllerSinkFrames() {
+  uint64_t frames = uart(SERIAL_USB_UART_NUM)->fakeTxFrames() + uart(SERIAL_BLE_UART_NUM)->fakeTxFrames();
+  for (size_t i = 0; i < tcpPeers.size(); i++) {
+    frames += tcpPeers[i]->txFrames;
+  }
+  return frames;
+}
+
+static void resetSinks() {
+  for (int i = 0; i < FAKE_UART_COUNT; i++) {
+    uart(i)->fakeResetCounters();
+  }
+  for (size_t i = 0; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->txBytes = 0;
+    tcpPeers[i]->txFrames = 0;
+    tcpPeers[i]->txWrites = 0;
+  }
+  WiFiUDP::fakeDatagrams = 0;
+}
+
+static void injectDe1(const char *frame) { uart(SERIAL_DE_UART_NUM)->fakeInject(frame); }
+static void injectBle(const char *frame) { uart(SERIAL_BLE_UART_NUM)->fakeInject(frame); }
+static void injectTcp(const char *frame) { tcpPeers[0]->peerSend(frame); }
+static void injectTcpPacked(const char *frame) {
+  uint8_t packed[PACKED_FRAME_MAX_SIZE];
+  tcpPeers[0]->peerSend(packed, packFrame(NULL, 0, (const uint8_t *)frame, strlen(frame), packed));
+}
+
+static bool readDe1() { return de1Serial.readAll(); }
+static bool readBle() { return controllers[1]->readAll(); }
+static bool readTcp() { return controllers[2]->readAll(); }
+// A full pass of loop(), including every interface's doLoop() and its profiling
+static bool loopOnce() { de1Serial.doLoop(); controllers.doLoop(); return false; }
+
+static uint64_t deliveredToControllers() { return controllerSinkFrames(); }
+static uint64_t deliveredToUdp() { return WiFiUDP::fakeDatagrams; }
+
+// Checks the sequence numbers of the UDP publisher's datagrams as they go out
+static uint32_t udpNextSequence;
+static uint32_t udpGaps;
+static void checkUdpSequence(const uint8_t *buf, size_t size) {
+  uint32_t sequence = strtoul(std::string((const char *)buf, size < 8 ? size : 8).c_str(), NULL, 16);
+  if (sequence != udpNextSequence) {
+    udpGaps++;
+  }
+  udpNextSequence = sequence + 1;
+}
+
+static void sumOverruns(const char *name, const PluckyInterfaceStats &stats, void *ctx) {
+  *(uint32_t *)ctx += stats.overruns;
+}
+
+// Regression checks: a failed one is reported and makes the benchmark exit non-zero
+static uint32_t benchFailures;
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    benchFailures++;
+  }
+}
+
+// Stands in for the shot store's writer task, draining the staging ring from another
+// thread as the task does from the other core, and checks each shot's records add up
+static std::atomic<bool> shotWriterStop(false);
+static std::atomic<uint32_t> shotsWritten(0);
+static uint64_t shotBytesWritten;
+static uint32_t shotChunks;
+static uint32_t shotsMalformed;
+static void checkShot(const std::vector<uint8_t> &shot) {
+  PluckyShotHeader header;
+  PluckyShotTrailer trailer;
+  if (shot.size() < sizeof(header) + sizeof(trailer)) {
+    shotsMalformed++;
+    return;
+  }
+  memcpy(&header, &shot[0], sizeof(header));
+  size_t offset = header.headerSize;
+  uint32_t frames = 0;
+  while (offset + 3 <= shot.size() && (shot[offset] | (shot[offset + 1] << 8)) != SHOT_TRAILER_MARK) {
+    offset += 2 + 1 + shot[offset + 2];
+    frames++;
+  }
+  memcpy(&trailer, &shot[offset], sizeof(trailer));
+  if (header.magic != SHOT_MAGIC || offset + sizeof(trailer) != shot.size() || trailer.numFrames != frames) {
+    shotsMalformed++;
+  }
+}
+static void shotWriter() {
+  uint8_t chunk[SHOT_WRITE_CHUNK];
+  std::vector<uint8_t> shot;
+  while (!shotWriterStop.load()) {
+    if (!shotRecorder.writeDue() || !shotRecorder.chunkReady()) {
+      std::this_thread::yield();
+      continue;
+    }
+    bool endOfShot;
+    size_t len = shotRecorder.take(chunk, sizeof(chunk), &endOfShot);
+    shot.insert(shot.end(), chunk, chunk + len);
+    shotBytesWritten += len;
+    shotChunks++;
+    if (endOfShot) {
+      checkShot(shot);
+      shot.clear();
+      shotsWritten++;
+    }
+  }
+}
+
+static uint64_t deliveredToDe1() { return uart(SERIAL_DE_UART_NUM)->fakeTxFrames(); }
+
+static BenchResult runScenario(const Scenario &s, uint32_t numFrames) {
+  BenchResult r;
+  r.frames = numFrames;
+  r.bytes = 0;
+  r.latencyNs.reserve(numFrames);
+
+  // Throughput: everything queued up front, drained by back-to-back readAll() calls
+  // the same way loop() would drain a backlog.
+  resetSinks();
+  for (uint32_t i = 0; i < numFrames; i++) {
+    const char *frame = s.frames[i % s.numFrames];
+    s.inject(frame);
+    r.bytes += strlen(frame);
+  }
+  BenchClock::time_point start = BenchClock::now();
+  while (s.readAll()) { }
+  r.seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+  r.delivered = s.delivered();
+
+  // Latency: one frame in flight at a time, timed from readAll() entry until
+  // the last destination write has returned.
+  for (uint32_t i = 0; i < numFrames; i++) {
+    s.inject(s.frames[i % s.numFrames]);
+    BenchClock::time_point t0 = BenchClock::now();
+    s.readAll();
+    BenchClock::time_point t1 = BenchClock::now();
+    r.latencyNs.push_back((uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+  }
+  std::sort(r.latencyNs.begin(), r.latencyNs.end());
+  return r;
+}
+
+// Average bytes each TCP client receives per DE1 frame
+static double tcpBytesPerDe1Frame(uint32_t numFrames) {
+  resetSinks();
+  for (uint32_t i = 0; i < numFrames; i++) {
+    injectDe1(de1Frames[i % NUM_DE1_FRAMES]);
+  }
+  while (readDe1()) { }
+  return (double)tcpPeers[0]->txBytes / numFrames;
+}
+
+// Average socket writes TCP client `peer` sees per DE1 frame, for a burst of frames
+// followed by the TCP port's doLoop() once a `windowMs` coalescing window has passed
+static double tcpWritesPerDe1Frame(uint32_t numFrames, size_t peer=0, uint16_t windowMs=0) {
+  resetSinks();
+  for (uint32_t i = 0; i < numFrames; i++) {
+    injectDe1(de1Frames[i % NUM_DE1_FRAMES]);
+  }
+  while (readDe1()) { }
+  delay(windowMs ? windowMs : userSettings.tcpCoalesceMs);
+  controllers[2]->doLoop();
+  return (double)tcpPeers[peer]->txWrites / numFrames;
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+  return sorted[i];
+}
+
+static void printResult(const char *name, const BenchResult &r) {
+  printf("%-28s %12.0f %14.0f %8u %8u %8u %10llu\n", name,
+         r.frames / r.seconds, r.bytes / r.seconds,
+         percentile(r.latencyNs, 0.50), percentile(r.latencyNs, 0.99), r.latencyNs.back(),
+         (unsigned long long)r.delivered);
+}
+
+class StdoutPrint : public Print {
+public:
+  size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t *buf, size_t size) { return fwrite(buf, 1, size, stdout); }
+};
+
+static void writeTraceToFile(const uint8_t *buf, size_t len, void *ctx) {
+  fwrite(buf, 1, len, (FILE *)ctx);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-n frames] [-c tcp_clients] [-m] [-p] [-t file] [-r shot]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+  uint32_t numFrames = 100000;
+  uint32_t numTcpClients = TCP_MAX_CLIENTS;
+  bool showMetrics = false;
+  bool showProfile = false;
+  const char *traceFile = NULL;
+  const char *replayFile = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      numFrames = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      numTcpClients = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-m") == 0) {
+      showMetrics = true;
+    } else if (strcmp(argv[i], "-p") == 0) {
+      showProfile = true;
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      traceFile = argv[++i];
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      replayFile = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (numFrames == 0 || numTcpClients == 0 || numTcpClients > TCP_MAX_CLIENTS) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // The shot for the DE1 simulator to replay, kept for the whole run
+  std::vector<uint8_t> replay;
+  if (replayFile) {
+    FILE *f = fopen(replayFile, "rb");
+    if (!f) {
+      perror(replayFile);
+      return 1;
+    }
+    uint8_t buf[4096];
+    size_t got;
+    while ((got = fread(buf, 1, sizeof(buf), f)) > 0) {
+      replay.insert(replay.end(), buf, buf + got);
+    }
+    fclose(f);
+    if (!de1Sim.load(replay.data(), replay.size())) {
+      fprintf(stderr, "%s: not a shot recording\n", replayFile);
+      return 1;
+    }
+  }
+
+  // Same bring-up sequence as setup() in main.cpp
+  userSettingStr_bleFlowControl = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpPort = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_promiscuous = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_routes = new char[USER_SETTING_ROUTES_STR_LEN];
+  userSettingStr_tcpOverflowPolicy = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpCoalesceMs = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpCoalesceBytes = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpMaxClients = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpIdleTimeoutS = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_udpAddress = new char[USER_SETTING_ADDRESS_STR_LEN];
+  userSettingStr_udpPort = new char[USER_SETTING_INT_STR_LEN];
+  sprintf(userSettingStr_bleFlowControl, DEFAULT_BLE_FLOW_CONTROL);
+  sprintf(userSettingStr_tcpPort, DEFAULT_TCP_PORT);
+  sprintf(userSettingStr_promiscuous, DEFAULT_PROMISCUOUS);
+  strcpy(userSettingStr_routes, DEFAULT_ROUTES);
+  sprintf(userSettingStr_tcpOverflowPolicy, DEFAULT_TCP_OVERFLOW_POLICY);
+  sprintf(userSettingStr_tcpCoalesceMs, DEFAULT_TCP_COALESCE_MS);
+  sprintf(userSettingStr_tcpCoalesceBytes, DEFAULT_TCP_COALESCE_BYTES);
+  sprintf(userSettingStr_tcpMaxClients, DEFAULT_TCP_MAX_CLIENTS);
+  sprintf(userSettingStr_tcpIdleTimeoutS, DEFAULT_TCP_IDLE_TIMEOUT_S);
+  strcpy(userSettingStr_udpAddress, DEFAULT_UDP_ADDRESS);
+  sprintf(userSettingStr_udpPort, DEFAULT_UDP_PORT);
+  userSettings.reload();
+
+  controllers[0] = new PluckyInterfaceSerial(SERIAL_USB_UART_NUM);
+  controllers[1] = new PluckyInterfaceSerial(SERIAL_BLE_UART_NUM);
+  tcpPort = new PluckyInterfaceTcpPort(userSettings.tcpPort);
+  controllers[2] = tcpPort;
+  controllers[3] = new PluckyInterfaceUdpPublisher();
+
+  de1Serial.doInit();
+  controllers.doInit();
+
+  router.attach(ROUTE_DE1, &de1Serial);
+  router.attach(ROUTE_USB, controllers[0]);
+  router.attach(ROUTE_BLE, controllers[1]);
+  router.attach(ROUTE_TCP, controllers[2]);
+  router.attach(ROUTE_UDP, controllers[3]);
+  router.rebuild();
+  userSettings.subscribe(SETTING_PROMISCUOUS | SETTING_ROUTES, PluckyRouter::settingsChanged_CB, &router);
+  frameFilter.compile(NULL);
+
+  // First doLoop() brings the TCP server up, the following ones accept the clients
+  controllers[2]->doLoop();
+  for (uint32_t i = 0; i < numTcpClients; i++) {
+    tcpPeers.push_back(WiFiServer::fakeConnect(userSettings.tcpPort, IPAddress(192, 168, 1, 10 + i), 50000 + i));
+    controllers[2]->doLoop();
+  }
+
+  // Logging is left unattached: the benchmark measures routing, not Serial printf.
+
+  // The [N]0404 among the DE1 frames starts a shot, so every DE1 scenario below is
+  // also being recorded, the way the bridge runs during a shot
+  std::thread shotWriterThread(shotWriter);
+
+  const Scenario scenarios[] = {
+    { "de1 -> controllers", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers },
+    { "ble -> de1", controllerFrames, NUM_CONTROLLER_FRAMES, injectBle, readBle, deliveredToDe1 },
+    { "tcp -> de1", controllerFrames, NUM_CONTROLLER_FRAMES, injectTcp, readTcp, deliveredToDe1 },
+    { "de1 -> controllers (loop)", de1Frames, NUM_DE1_FRAMES, injectDe1, loopOnce, deliveredToControllers },
+  };
+  const Scenario promiscuousScenarios[] = {
+    { "ble -> de1 (promiscuous)", controllerFrames, NUM_CONTROLLER_FRAMES, injectBle, readBle, deliveredToDe1 },
+    { "tcp -> de1 (promiscuous)", controllerFrames, NUM_CONTROLLER_FRAMES, injectTcp, readTcp, deliveredToDe1 },
+  };
+
+  printf("Plucky routing benchmark: %u frames per scenario, %u TCP clients\n", numFrames, numTcpClients);
+  printf("%-28s %12s %14s %8s %8s %8s %10s\n", "scenario", "frames/s", "bytes/s", "p50 ns", "p99 ns", "max ns", "delivered");
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    printResult(scenarios[i].name, runScenario(scenarios[i], numFrames));
+  }
+  sprintf(userSettingStr_promiscuous, "1");
+  userSettings.reload();
+  for (size_t i = 0; i < sizeof(promiscuousScenarios) / sizeof(promiscuousScenarios[0]); i++) {
+    printResult(promiscuousScenarios[i].name, runScenario(promiscuousScenarios[i], numFrames));
+  }
+  sprintf(userSettingStr_promiscuous, DEFAULT_PROMISCUOUS);
+
+  // BLE traffic mirrored, unprefixed, to the TCP clients as well as the DE1
+  sprintf(userSettingStr_routes, "BLE>TCP");
+  userSettings.reload();
+  const Scenario mirrored = { "ble -> de1 (mirror to TCP)", controllerFrames, NUM_CONTROLLER_FRAMES, injectBle, readBle, deliveredToDe1 };
+  printResult(mirrored.name, runScenario(mirrored, numFrames));
+  strcpy(userSettingStr_routes, DEFAULT_ROUTES);
+  userSettings.reload();
+
+  // Filter rules recompiled from another thread while DE1 frames stream through, as
+  // POST /filters does on the web core: every version drops [Q], so none may get past
+  // The first version goes in before any frame does, so none meets only the built-in rules
+  frameFilter.compile("DE1 [Q] drop\n");
+  std::atomic<bool> recompiling(true);
+  uint32_t recompiles = 1;
+  std::thread recompiler([&]() {
+    while (recompiling.load()) {
+      frameFilter.compile((recompiles++ & 1) ? "DE1 [Q] drop\n" : "DE1 [N] count\nDE1 [Q] drop\n");
+    }
+  });
+  const Scenario refiltered = { "de1 -> controllers (refilter)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers };
+  BenchResult refilteredResult = runScenario(refiltered, numFrames);
+  recompiling.store(false);
+  recompiler.join();
+  printResult(refiltered.name, refilteredResult);
+  uint64_t expectedDelivered = (uint64_t)numFrames * (NUM_DE1_FRAMES - 1) / NUM_DE1_FRAMES * (2 + numTcpClients);
+  printf("Filter recompiled %u times mid-stream: %lld frames delivered beyond the rules\n", recompiles,
+         (long long)(refilteredResult.delivered - expectedDelivered));
+  expect(refilteredResult.delivered == expectedDelivered, "recompiled filter rules applied to every frame");
+  frameFilter.compile(NULL);
+  // POST /filters refuses rule files with lines that would not take effect
+  StdoutPrint rejects;
+  int goodFileRejects = frameFilter.check("# site rules\nDE1 [Q] drop\n\nTCP <+M> count\n", rejects);
+  printf("Filter check: %d bad rules in a good file, and in a bad one:\n", goodFileRejects);
+  int badRules = frameFilter.check("DE1 [Q] dorp\nFOO [M] count\nDE1 [M] tap TCP\n", rejects);
+  printf("  %d bad rules\n", badRules);
+  expect(goodFileRejects == 0 && badRules == 2, "filter check finds exactly the bad rules");
+
+  // DE1 frames published once over UDP (to loopback, where tools/plucky_udp.py can
+  // listen) instead of once per TCP client
+  sprintf(userSettingStr_udpAddress, "127.0.0.1");
+  sprintf(userSettingStr_routes, "!DE1>TCP !DE1>USB !DE1>BLE");
+  userSettings.reload();
+  WiFiUDP::fakeOnSend = checkUdpSequence;
+  udpNextSequence = ((PluckyInterfaceUdpPublisher *)controllers[3])->getSequence();
+  const Scenario published = { "de1 -> udp (TCP unrouted)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToUdp };
+  printResult(published.name, runScenario(published, numFrames));
+  printf("UDP datagrams: %u sequence gaps, %u send failures\n", udpGaps, controllers[3]->getStats().writeDrops);
+  expect(udpGaps == 0 && controllers[3]->getStats().writeDrops == 0, "UDP datagrams sent in sequence");
+  WiFiUDP::fakeOnSend = NULL;
+  strcpy(userSettingStr_udpAddress, DEFAULT_UDP_ADDRESS);
+  strcpy(userSettingStr_routes, DEFAULT_ROUTES);
+  userSettings.reload();
+
+  // All but the first TCP client only want state changes, not shot samples
+  for (size_t i = 1; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->peerSend("!unsub M\n");
+  }
+  while (controllers[2]->readAll()) { }
+  const Scenario subscribed = { "de1 -> controllers (unsub M)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers };
+  printResult(subscribed.name, runScenario(subscribed, numFrames));
+  for (size_t i = 1; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->peerSend("!sub *\n");
+  }
+  while (controllers[2]->readAll()) { }
+
+  // ...or take them at a display-friendly 2 Hz, latest sample wins
+  for (size_t i = 1; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->peerSend("!rate M 2\n");
+  }
+  while (controllers[2]->readAll()) { }
+  const Scenario rateLimited = { "de1 -> controllers (rate M 2)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers };
+  printResult(rateLimited.name, runScenario(rateLimited, numFrames));
+  for (size_t i = 1; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->peerSend("!rate M 0\n");
+  }
+  while (controllers[2]->readAll()) { }
+
+  // Coalesce TCP frames over a 10 ms window
+  double immediateWritesPerFrame = tcpWritesPerDe1Frame(numFrames);
+  sprintf(userSettingStr_tcpCoalesceMs, "10");
+  userSettings.reload();
+  const Scenario coalesced = { "de1 -> controllers (coalesce)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers };
+  printResult(coalesced.name, runScenario(coalesced, numFrames));
+  double coalescedWritesPerFrame = tcpWritesPerDe1Frame(numFrames);
+  printf("TCP writes per DE1 frame: %.3f immediate, %.3f coalesced\n", immediateWritesPerFrame, coalescedWritesPerFrame);
+  expect(coalescedWritesPerFrame < immediateWritesPerFrame / 2, "coalescing halves TCP writes at least");
+  sprintf(userSettingStr_tcpCoalesceMs, DEFAULT_TCP_COALESCE_MS);
+  userSettings.reload();
+  controllers[2]->doLoop();
+
+  // ...or only for the one client that asks for it
+  if (tcpPeers.size() > 1) {
+    tcpPeers[0]->peerSend("!coalesce 10\n");
+    while (controllers[2]->readAll()) { }
+    double coalescingWritesPerFrame = tcpWritesPerDe1Frame(numFrames, 0, 10);
+    printf("TCP writes per DE1 frame with !coalesce 10 on one client: %.3f that client, %.3f the others\n",
+           coalescingWritesPerFrame, (double)tcpPeers[1]->txWrites / numFrames);
+    expect(coalescingWritesPerFrame < immediateWritesPerFrame / 2 && tcpPeers[1]->txWrites >= numFrames,
+           "!coalesce applies to the client that sent it only");
+    tcpPeers[0]->peerSend("!coalesce default\n");
+    while (controllers[2]->readAll()) { }
+    controllers[2]->doLoop();
+  }
+
+  // All TCP clients switch to packed binary framing
+  double asciiBytesPerFrame = tcpBytesPerDe1Frame(numFrames);
+  for (size_t i = 0; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->peerSend("!packed\n");
+  }
+  while (controllers[2]->readAll()) { }
+  for (size_t i = 0; i < tcpPeers.size(); i++) {
+    tcpPeers[i]->peerSetPacked(true);
+  }
+  const Scenario packedScenarios[] = {
+    { "de1 -> controllers (packed)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers },
+    { "tcp -> de1 (packed)", controllerFrames, NUM_CONTROLLER_FRAMES, injectTcpPacked, readTcp, deliveredToDe1 },
+  };
+  for (size_t i = 0; i < sizeof(packedScenarios) / sizeof(packedScenarios[0]); i++) {
+    printResult(packedScenarios[i].name, runScenario(packedScenarios[i], numFrames));
+  }
+  printf("TCP bytes per DE1 frame: %.1f ASCII, %.1f packed\n", asciiBytesPerFrame, tcpBytesPerDe1Frame(numFrames));
+
+  // One client stops reading (its TCP window closes); the others should not notice
+  tcpPeers.back()->peerSetWindow(0);
+  const Scenario stalled = { "de1 -> controllers (stalled)", de1Frames, NUM_DE1_FRAMES, injectDe1, readDe1, deliveredToControllers };
+  printResult(stalled.name, runScenario(stalled, numFrames));
+
+  // With the pool full, a newcomer should take the stalled client's slot
+  sprintf(userSettingStr_tcpMaxClients, "%u", numTcpClients);
+  userSettings.reload();
+  std::shared_ptr<FakeSocket> newcomer = WiFiServer::fakeConnect(userSettings.tcpPort, IPAddress(192, 168, 1, 99), 50099);
+  controllers[2]->doLoop();
+  printf("TCP pool: %u/%u clients, %u evicted; stalled client %s, newcomer %s\n",
+    tcpPort->getClientCount(), tcpPort->getPoolLimit(), tcpPort->getStats().evictions,
+    tcpPeers.back()->open ? "kept" : "evicted", newcomer->txBytes > 0 ? "served" : "not served");
+  expect(!tcpPeers.back()->open && newcomer->txBytes > 0, "newcomer takes the stalled TCP client's slot");
+
+  // Moving the TCP port takes effect without a restart and leaves connected clients be
+  newcomer->peerClose();
+  controllers[2]->doLoop();
+  uint16_t oldPort = userSettings.tcpPort;
+  uint16_t openBefore = tcpPort->getClientCount();
+  sprintf(userSettingStr_tcpPort, "%u", oldPort + 2);
+  userSettings.reload();
+  controllers[2]->doLoop();
+  uint16_t openAfter = tcpPort->getClientCount();
+  std::shared_ptr<FakeSocket> rebound = WiFiServer::fakeConnect(userSettings.tcpPort, IPAddress(192, 168, 1, 98), 50098);
+  controllers[2]->doLoop();
+  printf("TCP port %u -> %u: %u/%u clients still connected, newcomer on the new port %s\n",
+    oldPort, tcpPort->getPort(), openAfter, openBefore, rebound->txBytes > 0 ? "served" : "not served");
+  expect(openAfter == openBefore && rebound->txBytes > 0, "TCP port moves without dropping clients");
+
+  // A line that fills the read buffer leaves no room for its terminator and is purged;
+  // a packed length byte that could never complete gets the client closed
+  uint32_t overrunsBefore = 0;
+  tcpPort->visitStats(sumOverruns, &overrunsBefore);
+  std::string longLine = "!" + std::string(READ_BUFFER_SIZE - 2, 'x') + "\n";
+  rebound->peerSend(longLine.c_str());
+  while (controllers[2]->readAll()) { }
+  uint32_t overrunsAfter = 0;
+  tcpPort->visitStats(sumOverruns, &overrunsAfter);
+  bool keptAfterLine = rebound->open;
+  rebound->peerSend("!packed\n");
+  while (controllers[2]->readAll()) { }
+  const uint8_t hugeFrame[] = { 0xFF, '<', 'M' };
+  rebound->peerSend(hugeFrame, sizeof(hugeFrame));
+  while (controllers[2]->readAll()) { }
+  printf("TCP read buffer: %u overruns from a %u-byte line; client %s after a %u-byte packed frame\n",
+    overrunsAfter - overrunsBefore, (unsigned)longLine.size(), rebound->open ? "kept" : "closed", hugeFrame[0]);
+  expect(overrunsAfter - overrunsBefore == 1 && keptAfterLine && !rebound->open, "oversized TCP frames purged or refused");
+
+  // Browser dashboards on the WebSocket server, one of which stops reading: it should
+  // miss frames rather than hold up the others (the real socket write would block)
+  PluckyInterfaceWebSocket webSocket;
+  webSocket.doInit();
+  router.attach(ROUTE_WEBSOCKET, &webSocket);
+  router.rebuild();
+  std::vector<std::shared_ptr<FakeSocket> > wsPeers;
+  for (int i = 0; i < 3; i++) {
+    wsPeers.push_back(WiFiServer::fakeConnect(WEBSOCKET_PORT, IPAddress(192, 168, 1, 70 + i), 50070 + i));
+  }
+  webSocket.doLoop();
+  wsPeers.back()->peerSetWindow(FAKE_TCP_SNDLOWAT + 200);
+  for (size_t i = 0; i < wsPeers.size(); i++) {
+    wsPeers[i]->txFrames = 0;
+  }
+  uint32_t wsDropsBefore = webSocket.getStats().writeDrops;
+  BenchClock::time_point wsStart = BenchClock::now();
+  for (uint32_t i = 0; i < numFrames; i++) {
+    injectDe1(de1Frames[i % NUM_DE1_FRAMES]);
+    readDe1();
+  }
+  double wsSeconds = std::chrono::duration<double>(BenchClock::now() - wsStart).count();
+  printf("%-28s %12.0f %14s %8s %8s %8s %10llu\n", "de1 -> websocket (stalled)", numFrames / wsSeconds,
+         "-", "-", "-", "-", (unsigned long long)(wsPeers[0]->txFrames + wsPeers[1]->txFrames + wsPeers[2]->txFrames));
+  printf("WebSocket: %llu and %llu of %u frames to the reading clients, %llu to the stalled one; %u skipped, %llu sends would have blocked\n",
+         (unsigned long long)wsPeers[0]->txFrames, (unsigned long long)wsPeers[1]->txFrames, numFrames,
+         (unsigned long long)wsPeers[2]->txFrames, webSocket.getStats().writeDrops - wsDropsBefore,
+         (unsigned long long)WebSocketsServerCore::fakeBlockedSends);
+  expect(wsPeers[0]->txFrames == numFrames && wsPeers[1]->txFrames == numFrames &&
+         wsPeers[2]->txFrames < numFrames && WebSocketsServerCore::fakeBlockedSends == 0,
+         "stalled WebSocket client skipped without blocking the others");
+  router.attach(ROUTE_WEBSOCKET, NULL);
+  router.rebuild();
+
+  // The simulator standing in for the DE1: the BLE tablet asks for espresso and the shot
+  // replays as fast as the loop goes, over and over
+  de1Sim.doInit();
+  de1Sim.setSpeed(0);
+  de1Sim.setRepeat(true);
+  router.attach(ROUTE_DE1, &de1Sim);
+  de1 = &de1Sim;
+  resetSinks();
+  injectBle("<B>04\n");
+  readBle();
+  uint64_t simBytesBefore = de1Sim.getStats().bytesIn;
+  BenchClock::time_point simStart = BenchClock::now();
+  while (de1Sim.getStats().framesIn < numFrames) {
+    de1Sim.doLoop();
+  }
+  double simSeconds = std::chrono::duration<double>(BenchClock::now() - simStart).count();
+  printf("%-28s %12.0f %14.0f %8s %8s %8s %10llu\n", "de1 sim -> controllers",
+         de1Sim.getStats().framesIn / simSeconds, (de1Sim.getStats().bytesIn - simBytesBefore) / simSeconds,
+         "-", "-", "-", (unsigned long long)deliveredToControllers());
+
+  // Then once through at 100 times the recorded pace
+  injectBle("<B>02\n");
+  readBle();
+  de1Sim.doLoop();
+  de1Sim.setSpeed(100);
+  de1Sim.setRepeat(false);
+  injectBle("<B>04\n");
+  readBle();
+  simStart = BenchClock::now();
+  do {
+    de1Sim.doLoop();
+    delay(1);
+  } while (de1Sim.playing());
+  simSeconds = std::chrono::duration<double>(BenchClock::now() - simStart).count();
+  printf("DE1 simulator: %u shots replayed; once through at 100x took %.2f s, then state %u\n",
+         de1Sim.getReplays(), simSeconds, de1Sim.getState());
+  expect(de1Sim.getState() == DE1_STATE_IDLE, "simulator back to Idle after its shot");
+  // One with nothing to replay (never initialized) should not be left in Espresso
+  PluckyInterfaceDe1Sim emptySim;
+  emptySim.writeAll((const uint8_t *)"<B>04\n", 6);
+  emptySim.doLoop();
+  printf("DE1 simulator without a shot: espresso request leaves it in state %u\n", emptySim.getState());
+  expect(emptySim.getState() == DE1_STATE_IDLE, "simulator without a shot falls back to Idle");
+  router.attach(ROUTE_DE1, &de1Serial);
+  de1 = &de1Serial;
+
+  // The DE1 going idle ends the shot
+  injectDe1("[N]0200\n");
+  while (readDe1()) { }
+  while (shotsWritten.load() < shotRecorder.getShots()) {
+    std::this_thread::yield();
+  }
+  shotWriterStop.store(true);
+  shotWriterThread.join();
+  printf("Shot recorder: %u shots, %u frames staged, %u dropped; %llu bytes taken in %u chunks, %u malformed shots\n",
+    shotRecorder.getShots(), shotRecorder.getFrames(), shotRecorder.getDrops(),
+    (unsigned long long)shotBytesWritten, shotChunks, shotsMalformed);
+  expect(shotsMalformed == 0, "every recorded shot's records match its trailer");
+
+  if (showMetrics) {
+    printf("\n");
+    StdoutPrint out;
+    printMetrics(out);
+  }
+  if (showProfile) {
+    StdoutPrint out;
+    printf("\n");
+    profilerPrint(out);
+  }
+  if (traceFile) {
+    FILE *f = fopen(traceFile, "wb");
+    if (!f) {
+      perror(traceFile);
+      return 1;
+    }
+    flightRecorder.freeze();
+    flightRecorder.writeTrace(writeTraceToFile, f);
+    flightRecorder.resume();
+    fclose(f);
+  }
+  if (benchFailures) {
+    printf("%u checks FAILED\n", benchFailures);
+    return 1;
+  }
+  return 0;
+}
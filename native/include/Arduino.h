@@ -0,0 +1,135 @@
+#ifndef _PLUCKY_NATIVE_ARDUINO_H_
+#define _PLUCKY_NATIVE_ARDUINO_H_
+
+// Minimal host-side stand-in for the Arduino core, just enough to build the
+// Plucky interface layer on Linux for the [env:native] benchmarks.
+// Only the calls made by the Plucky sources are provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <string>
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+class String {
+public:
+  String() { }
+  String(const char *s) : _s(s ? s : "") { }
+  String(const std::string &s) : _s(s) { }
+  String(int n) : _s(std::to_string(n)) { }
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  bool endsWith(const String &suffix) const {
+    return _s.size() >= suffix._s.size() &&
+           _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+  }
+  bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+
+  String &operator +=(const String &rhs) { _s += rhs._s; return *this; }
+  String &operator +=(const char *rhs) { _s += rhs; return *this; }
+  String &operator +=(char c) { _s += c; return *this; }
+  String operator +(const String &rhs) const { return String(_s + rhs._s); }
+  String operator +(const char *rhs) const { return String(_s + rhs); }
+  bool operator ==(const String &rhs) const { return _s == rhs._s; }
+  bool operator ==(const char *rhs) const { return _s == rhs; }
+
+private:
+  std::string _s;
+};
+
+class Print {
+public:
+  virtual ~Print() { }
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buf++);
+    }
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  virtual int availableForWrite() { return 0; }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int n) { return printf("%d", n); }
+  size_t print(unsigned int n) { return printf("%u", n); }
+  size_t print(long n) { return printf("%ld", n); }
+  size_t print(unsigned long n) { return printf("%lu", n); }
+  size_t println() { return write("\r\n"); }
+  template <typename T> size_t println(T v) { return print(v) + println(); }
+
+  size_t printf(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0) {
+      return 0;
+    }
+    return write((const uint8_t *)buf, (size_t)len < sizeof(buf) ? (size_t)len : sizeof(buf) - 1);
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+class IPAddress {
+public:
+  IPAddress() : _addr(0) { }
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : _addr((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) { }
+  IPAddress(uint32_t addr) : _addr(addr) { }
+
+  bool fromString(const char *s) {
+    unsigned int a, b, c, d;
+    char extra;
+    if (sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+      return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+  }
+
+  uint8_t operator [](int i) const { return (uint8_t)(_addr >> (8 * i)); }
+  operator uint32_t() const { return _addr; }
+
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(buf);
+  }
+
+private:
+  uint32_t _addr;
+};
+
+class EspClass {
+public:
+  uint32_t getFreeHeap() { return 200000; }
+  uint64_t getEfuseMac() { return 0x0000deadbeef1234ULL; }
+  // A 240 MHz cycle counter derived from the host clock
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+};
+extern EspClass ESP;
+
+#include "HardwareSerial.h"
+
+#endif // _PLUCKY_NATIVE_ARDUINO_H_
@@ -0,0 +1,43 @@
+#ifndef _PLUCKY_NATIVE_ARDUINO_SIMPLE_LOGGING_H_
+#define _PLUCKY_NATIVE_ARDUINO_SIMPLE_LOGGING_H_
+
+#include "Arduino.h"
+
+// Host-side stand-in for ArduinoSimpleLogging.  Each level is a Print that
+// forwards to the handler registered with addHandler() when the handler's
+// level permits it, and otherwise discards the text.
+class SimpleLoggingClass {
+public:
+  enum Level { DEBUG = 0, INFO, WARNING, ERROR, SILENT };
+
+  class LevelStream : public Print {
+  public:
+    LevelStream(SimpleLoggingClass *parent, Level level) : _parent(parent), _level(level) { }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size);
+    using Print::write;
+  private:
+    SimpleLoggingClass *_parent;
+    Level _level;
+  };
+
+  SimpleLoggingClass();
+
+  void addHandler(Level level, Print &handler);
+  void removeHandler(Print &handler);
+
+  LevelStream debug;
+  LevelStream info;
+  LevelStream warning;
+  LevelStream error;
+
+private:
+  Print *_handler;
+  Level _handlerLevel;
+
+  friend class LevelStream;
+};
+
+extern SimpleLoggingClass Logger;
+
+#endif // _PLUCKY_NATIVE_ARDUINO_SIMPLE_LOGGING_H_
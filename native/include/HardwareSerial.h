@@ -0,0 +1,63 @@
+#ifndef _PLUCKY_NATIVE_HARDWARE_SERIAL_H_
+#define _PLUCKY_NATIVE_HARDWARE_SERIAL_H_
+
+#include <deque>
+#include <functional>
+
+#include "Arduino.h"
+
+#define SERIAL_8N1 0x800001c
+
+#define FAKE_UART_COUNT 3
+#define FAKE_UART_TX_CAPACITY 127  // matches the default ESP32 HardwareSerial TX buffer
+
+// In-memory UART.  Bytes injected with fakeInject() are handed out by read();
+// bytes written are counted (and the last write kept) instead of
+// being shifted out a pin.  TX drains instantly, so availableForWrite() only
+// reports less than the capacity when a test lowers it with fakeSetTxCapacity().
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial(int uart_nr);
+  ~HardwareSerial();
+
+  void begin(unsigned long baud, uint32_t config=SERIAL_8N1, int8_t rxPin=-1, int8_t txPin=-1);
+  void end();
+
+  int available();
+  int availableForWrite();
+  int peek();
+  int read();
+  size_t read(uint8_t *buffer, size_t size);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+
+  operator bool() const { return _started; }
+
+  // Called by fakeInject(), standing in for the driver's RX event
+  void onReceive(std::function<void(void)> function) { _onReceive = function; }
+
+  // Fake controls
+  static HardwareSerial *fakeForUart(int uart_nr);
+  void fakeInject(const uint8_t *buf, size_t size);
+  void fakeInject(const char *s) { fakeInject((const uint8_t *)s, strlen(s)); }
+  void fakeSetTxCapacity(int capacity) { _txCapacity = capacity; }
+  void fakeResetCounters();
+  uint64_t fakeTxBytes() const { return _txBytes; }
+  uint64_t fakeTxFrames() const { return _txFrames; }
+  const std::string &fakeLastTx() const { return _lastTx; }
+
+private:
+  int _uart_nr;
+  bool _started;
+  int _txCapacity;
+  std::deque<uint8_t> _rx;
+  uint64_t _txBytes;
+  uint64_t _txFrames;
+  std::string _lastTx;
+  std::function<void(void)> _onReceive;
+};
+
+extern HardwareSerial Serial;
+
+#endif // _PLUCKY_NATIVE_HARDWARE_SERIAL_H_
@@ -0,0 +1,86 @@
+#ifndef _PLUCKY_NATIVE_WEB_SOCKETS_SERVER_H_
+#define _PLUCKY_NATIVE_WEB_SOCKETS_SERVER_H_
+
+#include <functional>
+
+#include "Arduino.h"
+#include "WiFiServer.h"
+
+// Stand-in for the links2004 WebSockets server, with the same class layout
+// (WebSocketsServerCore holding the _clients[] table, WebSocketsServer adding the
+// listening socket) so subclasses see the same protected members.
+//
+// Connections come from WiFiServer::fakeConnect() on the server's port.  Each
+// '\n'-terminated line the peer sends arrives as one text message, and each text
+// message sent goes out as its payload plus '\n', so FakeSocket's frame counts work.
+// There is no handshake or framing.  The real library writes with a blocking
+// WiFiClient::write(); sends that the peer's window could not have taken whole are
+// counted in fakeBlockedSends() instead of stalling.
+
+#define WEBSOCKETS_SERVER_CLIENT_MAX 5
+
+typedef enum {
+  WStype_ERROR,
+  WStype_DISCONNECTED,
+  WStype_CONNECTED,
+  WStype_TEXT,
+  WStype_BIN,
+} WStype_t;
+
+typedef enum {
+  WSC_NOT_CONNECTED,
+  WSC_HEADER,
+  WSC_BODY,
+  WSC_CONNECTED
+} WSclientsStatus_t;
+
+typedef struct {
+  uint8_t num;
+  WSclientsStatus_t status;
+  WiFiClient *tcp;
+} WSclient_t;
+
+class WebSocketsServerCore {
+public:
+  typedef std::function<void(uint8_t num, WStype_t type, uint8_t *payload, size_t length)> WebSocketServerEvent;
+
+  WebSocketsServerCore();
+  virtual ~WebSocketsServerCore();
+
+  void onEvent(WebSocketServerEvent cbEvent) { _cbEvent = cbEvent; }
+
+  bool sendTXT(uint8_t num, const uint8_t *payload, size_t length=0, bool headerToPayload=false);
+  bool sendTXT(uint8_t num, const char *payload) { return sendTXT(num, (const uint8_t *)payload, strlen(payload)); }
+  bool broadcastTXT(const uint8_t *payload, size_t length=0, bool headerToPayload=false);
+
+  void disconnect();
+  void disconnect(uint8_t num);
+  int connectedClients(bool ping=false);
+  IPAddress remoteIP(uint8_t num);
+
+  // Fake controls: sends, by any server, that the real blocking write would have stalled on
+  static uint64_t fakeBlockedSends;
+
+protected:
+  void _accept(WiFiClient client);
+  void _poll();
+  void _clientDisconnect(WSclient_t *client);
+
+  WSclient_t _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+  WebSocketServerEvent _cbEvent;
+};
+
+class WebSocketsServer : public WebSocketsServerCore {
+public:
+  WebSocketsServer(uint16_t port) : _server(port), _port(port) { }
+
+  void begin() { _server.begin(_port); }
+  void close();
+  void loop();
+
+protected:
+  WiFiServer _server;
+  uint16_t _port;
+};
+
+#endif // _PLUCKY_NATIVE_WEB_SOCKETS_SERVER_H_
@@ -0,0 +1,32 @@
+#ifndef _PLUCKY_NATIVE_WIFI_H_
+#define _PLUCKY_NATIVE_WIFI_H_
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+class WiFiClass {
+public:
+  WiFiClass() : _status(WL_CONNECTED) { }
+  wl_status_t status() { return _status; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+
+  void fakeSetStatus(wl_status_t status) { _status = status; }
+
+private:
+  wl_status_t _status;
+};
+
+extern WiFiClass WiFi;
+
+#endif // _PLUCKY_NATIVE_WIFI_H_
@@ -0,0 +1,72 @@
+#ifndef _PLUCKY_NATIVE_WIFI_CLIENT_H_
+#define _PLUCKY_NATIVE_WIFI_CLIENT_H_
+
+#include <deque>
+#include <memory>
+#include <limits>
+
+#include "Arduino.h"
+
+// One in-memory TCP connection, shared between the bridge-side WiFiClient
+// and the benchmark acting as the remote peer.
+// The send window models the peer's TCP receive window: writes beyond it
+// would block (or fail with EAGAIN for MSG_DONTWAIT) until peerAck() opens it.
+struct FakeSocket {
+  FakeSocket() : fd(-1), open(true), txWindow(std::numeric_limits<size_t>::max()),
+                 txBytes(0), txFrames(0), txWrites(0), remotePort(0), packed(false), packedLeft(0) { }
+
+  // Peer side
+  void peerSend(const uint8_t *buf, size_t size) { rx.insert(rx.end(), buf, buf + size); }
+  void peerSend(const char *s) { peerSend((const uint8_t *)s, strlen(s)); }
+  void peerClose() { open = false; }
+  void peerSetWindow(size_t window) { txWindow = window; }
+  void peerAck(size_t bytes) { txWindow += bytes; }
+  // Count received frames by their length prefix rather than by '\n' (packed framing)
+  void peerSetPacked(bool isPacked) { packed = isPacked; packedLeft = 0; }
+
+  // Bridge side: accepts up to the window and returns the number of bytes taken
+  size_t accept(const uint8_t *buf, size_t size);
+
+  int fd;
+  bool open;
+  size_t txWindow;         // bytes the peer can still take before writes would block
+  std::deque<uint8_t> rx;  // bytes sent by the peer, not yet read by the bridge
+  uint64_t txBytes;        // bytes written by the bridge towards the peer
+  uint64_t txFrames;
+  uint64_t txWrites;       // send calls that moved at least one byte (~ TCP segments with Nagle off)
+  std::string lastTx;
+  IPAddress remoteIP;
+  uint16_t remotePort;
+  bool packed;
+  size_t packedLeft;       // bytes still to come of the packed frame being received
+};
+
+class WiFiClient : public Stream {
+public:
+  WiFiClient() { }
+  WiFiClient(std::shared_ptr<FakeSocket> sock) : _sock(sock) { }
+
+  uint8_t connected() { return _sock && _sock->open; }
+  int available();
+  int peek();
+  int read();
+  int read(uint8_t *buf, size_t size);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size);
+  using Print::write;
+  void stop();
+
+  int fd() const { return _sock ? _sock->fd : -1; }
+  int setNoDelay(bool nodelay) { return 0; }
+  IPAddress remoteIP() const { return _sock ? _sock->remoteIP : IPAddress(); }
+  uint16_t remotePort() const { return _sock ? _sock->remotePort : 0; }
+
+  operator bool() { return connected(); }
+
+  std::shared_ptr<FakeSocket> fakeSocket() { return _sock; }
+
+private:
+  std::shared_ptr<FakeSocket> _sock;
+};
+
+#endif // _PLUCKY_NATIVE_WIFI_CLIENT_H_
@@ -0,0 +1,35 @@
+#ifndef _PLUCKY_NATIVE_WIFI_SERVER_H_
+#define _PLUCKY_NATIVE_WIFI_SERVER_H_
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+// Listening socket stand-in.  Connections are queued per port by
+// fakeConnect() and handed out by available() once the server has begun.
+class WiFiServer {
+public:
+  WiFiServer(uint16_t port=80, uint8_t max_clients=4)
+    : _port(port), _maxClients(max_clients), _listening(false), _noDelay(false) { }
+
+  void begin(uint16_t port=0);
+  void end();
+  void close() { end(); }
+  void stop() { end(); }
+  bool hasClient();
+  WiFiClient available();
+  void setNoDelay(bool nodelay) { _noDelay = nodelay; }
+  bool getNoDelay() { return _noDelay; }
+
+  operator bool() { return _listening; }
+
+  // Fake controls
+  static std::shared_ptr<FakeSocket> fakeConnect(uint16_t port, IPAddress ip, uint16_t remotePort);
+
+private:
+  uint16_t _port;
+  uint8_t _maxClients;
+  bool _listening;
+  bool _noDelay;
+};
+
+#endif // _PLUCKY_NATIVE_WIFI_SERVER_H_
@@ -0,0 +1,35 @@
+#ifndef _PLUCKY_NATIVE_WIFI_UDP_H_
+#define _PLUCKY_NATIVE_WIFI_UDP_H_
+
+#include <string>
+
+#include "Arduino.h"
+
+// UDP sender stand-in.  Every datagram is counted and handed to fakeOnSend (if set),
+// and, since a host has real sockets, actually sent as well so a listener such as
+// tools/plucky_udp.py can receive it over loopback.
+class WiFiUDP : public Print {
+public:
+  WiFiUDP() : _fd(-1), _port(0), _open(false) { }
+  ~WiFiUDP() { stop(); }
+
+  int beginPacket(IPAddress ip, uint16_t port);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t size);
+  using Print::write;
+  int endPacket();
+  void stop();
+
+  // Fake controls
+  static void (*fakeOnSend)(const uint8_t *buf, size_t size);
+  static uint64_t fakeDatagrams;
+
+private:
+  int _fd;
+  IPAddress _ip;
+  uint16_t _port;
+  bool _open;
+  std::string _packet;
+};
+
+#endif // _PLUCKY_NATIVE_WIFI_UDP_H_
@@ -0,0 +1,34 @@
+#ifndef _PLUCKY_NATIVE_DRIVER_UART_H_
+#define _PLUCKY_NATIVE_DRIVER_UART_H_
+
+// Host-side stand-in for the ESP-IDF UART/GPIO driver calls made by
+// PluckyInterfaceSerial.  Pin and flow control setup is accepted and ignored.
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef int uart_port_t;
+#define UART_NUM_0 (0)
+#define UART_NUM_1 (1)
+#define UART_NUM_2 (2)
+
+#define UART_PIN_NO_CHANGE (-1)
+
+typedef enum {
+  UART_HW_FLOWCTRL_DISABLE = 0x0,
+  UART_HW_FLOWCTRL_RTS = 0x1,
+  UART_HW_FLOWCTRL_CTS = 0x2,
+  UART_HW_FLOWCTRL_CTS_RTS = 0x3,
+} uart_hw_flowcontrol_t;
+
+typedef int gpio_num_t;
+
+inline esp_err_t uart_set_hw_flow_ctrl(uart_port_t, uart_hw_flowcontrol_t, uint8_t) { return ESP_OK; }
+inline esp_err_t uart_set_pin(uart_port_t, int, int, int, int) { return ESP_OK; }
+inline esp_err_t gpio_pullup_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_pulldown_en(gpio_num_t) { return ESP_OK; }
+inline esp_err_t gpio_reset_pin(gpio_num_t) { return ESP_OK; }
+
+#endif // _PLUCKY_NATIVE_DRIVER_UART_H_
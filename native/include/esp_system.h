@@ -0,0 +1,8 @@
+#ifndef _PLUCKY_NATIVE_ESP_SYSTEM_H_
+#define _PLUCKY_NATIVE_ESP_SYSTEM_H_
+
+#include <stdint.h>
+
+inline uint32_t esp_get_free_heap_size() { return 200000; }
+
+#endif // _PLUCKY_NATIVE_ESP_SYSTEM_H_
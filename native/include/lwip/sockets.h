@@ -0,0 +1,34 @@
+#ifndef _PLUCKY_NATIVE_LWIP_SOCKETS_H_
+#define _PLUCKY_NATIVE_LWIP_SOCKETS_H_
+
+// Host-side stand-in for the lwIP socket calls Plucky makes directly on a
+// WiFiClient's fd().  They operate on the FakeSocket behind that fd.
+
+#include <errno.h>
+#include <stddef.h>
+#include <sys/select.h>
+
+#ifndef MSG_DONTWAIT
+#define MSG_DONTWAIT 0x08
+#endif
+
+// Option numbers as lwIP defines them
+#define SOL_SOCKET 0xfff
+#define SO_KEEPALIVE 0x0008
+#define IPPROTO_TCP 6
+#define TCP_KEEPIDLE 0x03
+#define TCP_KEEPINTVL 0x04
+#define TCP_KEEPCNT 0x05
+
+// lwIP only reports a socket writable while more than TCP_SNDLOWAT bytes of its send
+// buffer are free (2 * TCP_MSS + 1 with the ESP-IDF defaults)
+#define FAKE_TCP_SNDLOWAT 2873
+
+int lwip_send(int s, const void *dataptr, size_t size, int flags);
+// Accepted and ignored for open sockets
+// Write readiness only: an open socket whose window has more than FAKE_TCP_SNDLOWAT
+// bytes free.  Never waits; timeout is ignored.
+int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout);
+int lwip_setsockopt(int s, int level, int optname, const void *optval, unsigned int optlen);
+
+#endif // _PLUCKY_NATIVE_LWIP_SOCKETS_H_
@@ -0,0 +1,31 @@
+#include <chrono>
+#include <thread>
+
+#include "Arduino.h"
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - bootTime).count() * 240 / 1000);
+}
@@ -0,0 +1,27 @@
+#include "ArduinoSimpleLogging.h"
+
+SimpleLoggingClass Logger;
+
+SimpleLoggingClass::SimpleLoggingClass()
+  : debug(this, DEBUG), info(this, INFO), warning(this, WARNING), error(this, ERROR),
+    _handler(NULL), _handlerLevel(SILENT) {
+}
+
+void SimpleLoggingClass::addHandler(Level level, Print &handler) {
+  _handler = &handler;
+  _handlerLevel = level;
+}
+
+void SimpleLoggingClass::removeHandler(Print &handler) {
+  if (_handler == &handler) {
+    _handler = NULL;
+    _handlerLevel = SILENT;
+  }
+}
+
+size_t SimpleLoggingClass::LevelStream::write(const uint8_t *buf, size_t size) {
+  if (!_parent->_handler || _level < _parent->_handlerLevel) {
+    return size;
+  }
+  return _parent->_handler->write(buf, size);
+}
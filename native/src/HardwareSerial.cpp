@@ -0,0 +1,96 @@
+#include <algorithm>
+
+#include "HardwareSerial.h"
+
+static HardwareSerial *fakeUarts[FAKE_UART_COUNT];
+
+HardwareSerial Serial(0);
+
+HardwareSerial::HardwareSerial(int uart_nr) {
+  _uart_nr = uart_nr;
+  _started = false;
+  _txCapacity = FAKE_UART_TX_CAPACITY;
+  _txBytes = 0;
+  _txFrames = 0;
+  if (uart_nr >= 0 && uart_nr < FAKE_UART_COUNT) {
+    fakeUarts[uart_nr] = this;
+  }
+}
+
+HardwareSerial::~HardwareSerial() {
+  if (_uart_nr >= 0 && _uart_nr < FAKE_UART_COUNT && fakeUarts[_uart_nr] == this) {
+    fakeUarts[_uart_nr] = NULL;
+  }
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+  _started = true;
+}
+
+void HardwareSerial::end() {
+  _started = false;
+  _rx.clear();
+}
+
+int HardwareSerial::available() {
+  return _rx.size();
+}
+
+int HardwareSerial::availableForWrite() {
+  return _txCapacity;
+}
+
+int HardwareSerial::peek() {
+  return _rx.empty() ? -1 : _rx.front();
+}
+
+int HardwareSerial::read() {
+  if (_rx.empty()) {
+    return -1;
+  }
+  uint8_t c = _rx.front();
+  _rx.pop_front();
+  return c;
+}
+
+size_t HardwareSerial::read(uint8_t *buffer, size_t size) {
+  if (size > _rx.size()) {
+    size = _rx.size();
+  }
+  std::copy(_rx.begin(), _rx.begin() + size, buffer);
+  _rx.erase(_rx.begin(), _rx.begin() + size);
+  return size;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  _txBytes += size;
+  for (const uint8_t *p = buffer; (p = (const uint8_t *)memchr(p, '\n', buffer + size - p)) != NULL; p++) {
+    _txFrames++;
+  }
+  _lastTx.assign((const char *)buffer, size);
+  return size;
+}
+
+HardwareSerial *HardwareSerial::fakeForUart(int uart_nr) {
+  if (uart_nr < 0 || uart_nr >= FAKE_UART_COUNT) {
+    return NULL;
+  }
+  return fakeUarts[uart_nr];
+}
+
+void HardwareSerial::fakeInject(const uint8_t *buf, size_t size) {
+  _rx.insert(_rx.end(), buf, buf + size);
+  if (_onReceive) {
+    _onReceive();
+  }
+}
+
+void HardwareSerial::fakeResetCounters() {
+  _txBytes = 0;
+  _txFrames = 0;
+  _lastTx.clear();
+}
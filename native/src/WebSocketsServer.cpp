@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <string>
+
+#include "WebSocketsServer.h"
+
+uint64_t WebSocketsServerCore::fakeBlockedSends = 0;
+
+WebSocketsServerCore::WebSocketsServerCore() {
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    _clients[i].num = i;
+    _clients[i].status = WSC_NOT_CONNECTED;
+    _clients[i].tcp = NULL;
+  }
+}
+
+WebSocketsServerCore::~WebSocketsServerCore() {
+  disconnect();
+}
+
+bool WebSocketsServerCore::sendTXT(uint8_t num, const uint8_t *payload, size_t length, bool headerToPayload) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || _clients[num].status != WSC_CONNECTED) {
+    return false;
+  }
+  WiFiClient *tcp = _clients[num].tcp;
+  if (tcp->fakeSocket()->txWindow < length + 1) {
+    fakeBlockedSends++;
+  }
+  size_t written = tcp->write(payload, length);
+  written += tcp->write((const uint8_t *)"\n", 1);
+  return written == length + 1;
+}
+
+bool WebSocketsServerCore::broadcastTXT(const uint8_t *payload, size_t length, bool headerToPayload) {
+  bool ok = true;
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    if (_clients[i].status == WSC_CONNECTED) {
+      ok &= sendTXT(i, payload, length);
+    }
+  }
+  return ok;
+}
+
+void WebSocketsServerCore::disconnect() {
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    disconnect(i);
+  }
+}
+
+void WebSocketsServerCore::disconnect(uint8_t num) {
+  if (num < WEBSOCKETS_SERVER_CLIENT_MAX && _clients[num].status != WSC_NOT_CONNECTED) {
+    _clientDisconnect(&_clients[num]);
+  }
+}
+
+int WebSocketsServerCore::connectedClients(bool ping) {
+  int count = 0;
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    if (_clients[i].status == WSC_CONNECTED) {
+      count++;
+    }
+  }
+  return count;
+}
+
+IPAddress WebSocketsServerCore::remoteIP(uint8_t num) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || _clients[num].status != WSC_CONNECTED) {
+    return IPAddress();
+  }
+  return _clients[num].tcp->remoteIP();
+}
+
+void WebSocketsServerCore::_accept(WiFiClient client) {
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    if (_clients[i].status == WSC_NOT_CONNECTED) {
+      _clients[i].tcp = new WiFiClient(client);
+      _clients[i].status = WSC_CONNECTED;
+      if (_cbEvent) {
+        _cbEvent(i, WStype_CONNECTED, NULL, 0);
+      }
+      return;
+    }
+  }
+  client.stop();
+}
+
+void WebSocketsServerCore::_poll() {
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    WSclient_t *client = &_clients[i];
+    if (client->status != WSC_CONNECTED) {
+      continue;
+    }
+    if (!client->tcp->connected()) {
+      _clientDisconnect(client);
+      continue;
+    }
+    std::deque<uint8_t> &rx = client->tcp->fakeSocket()->rx;
+    std::deque<uint8_t>::iterator lf;
+    while ((lf = std::find(rx.begin(), rx.end(), '\n')) != rx.end()) {
+      std::string message(rx.begin(), lf);
+      rx.erase(rx.begin(), lf + 1);
+      if (_cbEvent) {
+        _cbEvent(i, WStype_TEXT, (uint8_t *)&message[0], message.size());
+      }
+    }
+  }
+}
+
+void WebSocketsServerCore::_clientDisconnect(WSclient_t *client) {
+  client->tcp->stop();
+  delete client->tcp;
+  client->tcp = NULL;
+  client->status = WSC_NOT_CONNECTED;
+  if (_cbEvent) {
+    _cbEvent(client->num, WStype_DISCONNECTED, NULL, 0);
+  }
+}
+
+void WebSocketsServer::close() {
+  disconnect();
+  _server.end();
+}
+
+void WebSocketsServer::loop() {
+  while (_server.hasClient()) {
+    _accept(_server.available());
+  }
+  _poll();
+}
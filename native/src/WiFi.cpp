@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <map>
+
+#include "WiFi.h"
+#include "lwip/sockets.h"
+
+WiFiClass WiFi;
+
+static std::map<uint16_t, std::deque<std::shared_ptr<FakeSocket> > > pendingConnections;
+static std::map<int, std::weak_ptr<FakeSocket> > socketsByFd;
+static int nextFd = 3;
+
+size_t FakeSocket::accept(const uint8_t *buf, size_t size) {
+  if (size > txWindow) {
+    size = txWindow;
+  }
+  txWindow -= size;
+  txBytes += size;
+  if (size > 0) {
+    txWrites++;
+  }
+  if (packed) {
+    for (size_t i = 0; i < size; i++) {
+      if (packedLeft == 0) {
+        packedLeft = buf[i];
+      } else if (--packedLeft == 0) {
+        txFrames++;
+      }
+    }
+  } else {
+    for (const uint8_t *p = buf; (p = (const uint8_t *)memchr(p, '\n', buf + size - p)) != NULL; p++) {
+      txFrames++;
+    }
+  }
+  lastTx.assign((const char *)buf, size);
+  return size;
+}
+
+int WiFiClient::available() {
+  return _sock ? _sock->rx.size() : 0;
+}
+
+int WiFiClient::peek() {
+  return (_sock && !_sock->rx.empty()) ? _sock->rx.front() : -1;
+}
+
+int WiFiClient::read() {
+  if (!_sock || _sock->rx.empty()) {
+    return -1;
+  }
+  uint8_t c = _sock->rx.front();
+  _sock->rx.pop_front();
+  return c;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size) {
+  if (!_sock) {
+    return -1;
+  }
+  if (size > _sock->rx.size()) {
+    size = _sock->rx.size();
+  }
+  std::copy(_sock->rx.begin(), _sock->rx.begin() + size, buf);
+  _sock->rx.erase(_sock->rx.begin(), _sock->rx.begin() + size);
+  return size;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size) {
+  // The real (blocking) write would stall here until the window opens; the
+  // fake just takes what fits.
+  if (!connected()) {
+    return 0;
+  }
+  return _sock->accept(buf, size);
+}
+
+void WiFiClient::stop() {
+  if (_sock) {
+    _sock->open = false;
+    _sock.reset();
+  }
+}
+
+void WiFiServer::begin(uint16_t port) {
+  if (port) {
+    _port = port;
+  }
+  _listening = true;
+}
+
+void WiFiServer::end() {
+  _listening = false;
+}
+
+bool WiFiServer::hasClient() {
+  return _listening && !pendingConnections[_port].empty();
+}
+
+WiFiClient WiFiServer::available() {
+  std::deque<std::shared_ptr<FakeSocket> > &pending = pendingConnections[_port];
+  if (!_listening || pending.empty()) {
+    return WiFiClient();
+  }
+  std::shared_ptr<FakeSocket> sock = pending.front();
+  pending.pop_front();
+  return WiFiClient(sock);
+}
+
+std::shared_ptr<FakeSocket> WiFiServer::fakeConnect(uint16_t port, IPAddress ip, uint16_t remotePort) {
+  std::shared_ptr<FakeSocket> sock = std::make_shared<FakeSocket>();
+  sock->remoteIP = ip;
+  sock->remotePort = remotePort;
+  sock->fd = nextFd++;
+  socketsByFd[sock->fd] = sock;
+  pendingConnections[port].push_back(sock);
+  return sock;
+}
+
+int lwip_send(int s, const void *dataptr, size_t size, int flags) {
+  std::map<int, std::weak_ptr<FakeSocket> >::iterator it = socketsByFd.find(s);
+  std::shared_ptr<FakeSocket> sock;
+  if (it != socketsByFd.end()) {
+    sock = it->second.lock();
+  }
+  if (!sock || !sock->open) {
+    errno = ECONNRESET;
+    return -1;
+  }
+  if (size > 0 && sock->txWindow == 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+  return sock->accept((const uint8_t *)dataptr, size);
+}
+
+int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout) {
+  int ready = 0;
+  for (int fd = 0; fd < maxfdp1; fd++) {
+    if (readset) {
+      FD_CLR(fd, readset);
+    }
+    if (exceptset) {
+      FD_CLR(fd, exceptset);
+    }
+    if (!writeset || !FD_ISSET(fd, writeset)) {
+      continue;
+    }
+    std::map<int, std::weak_ptr<FakeSocket> >::iterator it = socketsByFd.find(fd);
+    std::shared_ptr<FakeSocket> sock;
+    if (it != socketsByFd.end()) {
+      sock = it->second.lock();
+    }
+    if (sock && sock->open && sock->txWindow > FAKE_TCP_SNDLOWAT) {
+      ready++;
+    } else {
+      FD_CLR(fd, writeset);
+    }
+  }
+  return ready;
+}
+
+int lwip_setsockopt(int s, int level, int optname, const void *optval, unsigned int optlen) {
+  std::map<int, std::weak_ptr<FakeSocket> >::iterator it = socketsByFd.find(s);
+  if (it == socketsByFd.end() || it->second.expired()) {
+    errno = EBADF;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "WiFiUdp.h"
+
+void (*WiFiUDP::fakeOnSend)(const uint8_t *buf, size_t size) = NULL;
+uint64_t WiFiUDP::fakeDatagrams = 0;
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  if (_fd < 0) {
+    _fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_fd < 0) {
+      return 0;
+    }
+    int enable = 1;
+    setsockopt(_fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+  }
+  _ip = ip;
+  _port = port;
+  _packet.clear();
+  _open = true;
+  return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t *buf, size_t size) {
+  if (!_open) {
+    return 0;
+  }
+  _packet.append((const char *)buf, size);
+  return size;
+}
+
+int WiFiUDP::endPacket() {
+  if (!_open) {
+    return 0;
+  }
+  _open = false;
+  fakeDatagrams++;
+  if (fakeOnSend) {
+    fakeOnSend((const uint8_t *)_packet.data(), _packet.size());
+  }
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = (uint32_t)_ip;  // both in network byte order
+  return sendto(_fd, _packet.data(), _packet.size(), 0, (sockaddr *)&addr, sizeof(addr)) < 0 ? 0 : 1;
+}
+
+void WiFiUDP::stop() {
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+  _open = false;
+}
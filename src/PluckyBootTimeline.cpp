@@ -0,0 +1,47 @@
+#include <ArduinoSimpleLogging.h>
+#include <atomic>
+
+#include "PluckyBootTimeline.hpp"
+
+static struct {
+  const char *name;
+  uint32_t micros;
+} milestones[BOOT_MAX_MILESTONES];
+static std::atomic<uint8_t> numMilestones(0);
+
+void bootMilestone(const char *name) {
+  uint32_t now = micros();
+  uint8_t count = numMilestones.load(std::memory_order_acquire);
+  for (uint8_t i = 0; i < count && i < BOOT_MAX_MILESTONES; i++) {
+    if (milestones[i].name == name) {
+      return;
+    }
+  }
+  uint8_t slot = numMilestones.fetch_add(1);
+  if (slot >= BOOT_MAX_MILESTONES) {
+    return;
+  }
+  milestones[slot].micros = now;
+  milestones[slot].name = name;
+  Logger.info.printf("Boot: %lu.%03lu ms %s\n", (unsigned long)(now / 1000), (unsigned long)(now % 1000), name);
+}
+
+void bootTimelinePrint(Print &out) {
+  uint8_t count = numMilestones.load(std::memory_order_acquire);
+  if (count > BOOT_MAX_MILESTONES) {
+    count = BOOT_MAX_MILESTONES;
+  }
+  out.printf("%12s %12s  %s\n", "ms", "+ms", "milestone");
+  uint32_t previous = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const char *name = milestones[i].name;
+    if (!name) {
+      continue;  // claimed but not filled in yet
+    }
+    uint32_t at = milestones[i].micros;
+    uint32_t delta = at - previous;
+    out.printf("%8lu.%03lu %8lu.%03lu  %s\n", (unsigned long)(at / 1000), (unsigned long)(at % 1000),
+      (unsigned long)(delta / 1000), (unsigned long)(delta % 1000), name);
+    previous = at;
+  }
+}
@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include <ArduinoSimpleLogging.h>
+
+#include "PluckyBridgeTask.hpp"
+#include "PluckyInterfaceSerial.hpp"
+
+#if ENABLE_DUAL_CORE_BRIDGE
+
+static TaskHandle_t bridgeTaskHandle = NULL;
+static PluckyInterfaceSerial **bridgeInterfaces;
+static uint8_t bridgeNumInterfaces;
+static PluckyInterface *bridgeSimulated;
+
+// Counters for bridgeTaskPrintStats()
+static volatile uint32_t bridgeWakeups = 0;
+static volatile uint32_t bridgeBusyMicros = 0;
+static volatile uint32_t bridgeRxWaits = 0;
+static volatile uint32_t bridgeRxWaitMicros = 0;
+static volatile uint32_t bridgeRxWaitMaxMicros = 0;
+static unsigned long bridgeStatsSince = 0;
+
+#if ENABLE_UART_EVENT_RX
+// Ticks to sleep when no UART has signalled data and nothing was queued; only a safety net
+#define BRIDGE_EVENT_IDLE_TICKS pdMS_TO_TICKS(100)
+#endif // ENABLE_UART_EVENT_RX
+
+static void bridgeTask(void *param) {
+  for (;;) {
+    unsigned long start = micros();
+    for (uint8_t i=0; i<bridgeNumInterfaces; i++) {
+      bridgeInterfaces[i]->doLoop();
+    }
+    if (bridgeSimulated) {
+      bridgeSimulated->doLoop();
+    }
+    bridgeBusyMicros += micros() - start;
+    bridgeWakeups++;
+
+#if ENABLE_UART_EVENT_RX
+    // Sleep until a UART's onReceive callback or loop() wakes us.  Commands waiting on TX
+    // buffer space get no wakeup, so poll for them every tick, as well as a simulated
+    // interface that has frames to send.
+    TickType_t idleTicks = (bridgeSimulated && bridgeSimulated->available()) ? 1 : BRIDGE_EVENT_IDLE_TICKS;
+    for (uint8_t i=0; i<bridgeNumInterfaces; i++) {
+      if (bridgeInterfaces[i]->hasQueuedCommands()) {
+        idleTicks = 1;
+        break;
+      }
+    }
+    ulTaskNotifyTake(pdTRUE, idleTicks);
+#else
+    // Sleep until the next tick, or until loop() hands us a frame for one of our UARTs
+    ulTaskNotifyTake(pdTRUE, 1);
+#endif // ENABLE_UART_EVENT_RX
+  }
+}
+
+void bridgeTaskBegin(PluckyInterfaceSerial **interfaces, uint8_t numInterfaces, PluckyInterface *simulated) {
+  bridgeInterfaces = interfaces;
+  bridgeNumInterfaces = numInterfaces;
+  bridgeSimulated = simulated;
+
+  bridgeStatsSince = millis();
+  xTaskCreatePinnedToCore(bridgeTask, "plucky_bridge", BRIDGE_TASK_STACK_SIZE, NULL,
+                          BRIDGE_TASK_PRIORITY, &bridgeTaskHandle, BRIDGE_TASK_CORE);
+  Logger.info.printf("UART bridge task started on core %d (%s receive)\n", BRIDGE_TASK_CORE,
+                     ENABLE_UART_EVENT_RX ? "event-driven" : "polled");
+}
+
+bool bridgeTaskRunning() {
+  return bridgeTaskHandle != NULL;
+}
+
+bool inBridgeTask() {
+  return bridgeTaskHandle != NULL && xTaskGetCurrentTaskHandle() == bridgeTaskHandle;
+}
+
+void bridgeTaskWake() {
+  if (bridgeTaskHandle != NULL) {
+    xTaskNotifyGive(bridgeTaskHandle);
+  }
+}
+
+void bridgeTaskRecordRxWait(uint32_t us) {
+  bridgeRxWaits++;
+  bridgeRxWaitMicros += us;
+  if (us > bridgeRxWaitMaxMicros) {
+    bridgeRxWaitMaxMicros = us;
+  }
+}
+
+void bridgeTaskPrintStats(Print &out) {
+  unsigned long elapsed = millis() - bridgeStatsSince;
+  uint32_t wakeups = bridgeWakeups;
+  uint32_t busy = bridgeBusyMicros;
+  uint32_t rxWaits = bridgeRxWaits;
+  out.printf("Bridge task (%s): %u wakeups, %u us busy in %lu ms (%lu wakeups/s, %u us/wakeup)\n",
+             ENABLE_UART_EVENT_RX ? "event-driven" : "polled", wakeups, busy, elapsed,
+             elapsed ? (unsigned long)wakeups * 1000 / elapsed : 0, wakeups ? busy / wakeups : 0);
+  out.printf("Bridge task: %u UART receive signals read after %u us on average, %u us at most\n",
+             rxWaits, rxWaits ? bridgeRxWaitMicros / rxWaits : 0, bridgeRxWaitMaxMicros);
+  bridgeWakeups = 0;
+  bridgeBusyMicros = 0;
+  bridgeRxWaits = 0;
+  bridgeRxWaitMicros = 0;
+  bridgeRxWaitMaxMicros = 0;
+  bridgeStatsSince = millis();
+}
+
+#endif // ENABLE_DUAL_CORE_BRIDGE
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "PluckyCommandQueue.hpp"
+
+PluckyCommandQueue::PluckyCommandQueue() {
+  memset(_stats, 0, sizeof(_stats));
+  _turn = 0;
+  _current = 0;
+}
+
+bool PluckyCommandQueue::push(uint8_t lane, const uint8_t *prefix, size_t prefixLen, const uint8_t *buf, size_t len) {
+  if (lane >= DE1_QUEUE_NUM_LANES) {
+    lane = DE1_QUEUE_LANE_OTHER;
+  }
+  if (!_lanes[lane].push(prefix, prefixLen, buf, len)) {
+    _stats[lane].dropped++;
+    return false;
+  }
+  _stats[lane].queued++;
+  return true;
+}
+
+const uint8_t *PluckyCommandQueue::next(size_t *len) {
+  for (uint8_t i = 0; i < DE1_QUEUE_NUM_LANES; i++) {
+    uint8_t lane = (_turn + i) % DE1_QUEUE_NUM_LANES;
+    const uint8_t *frame = _lanes[lane].front(len);
+    if (frame) {
+      _current = lane;
+      return frame;
+    }
+  }
+  return NULL;
+}
+
+void PluckyCommandQueue::pop() {
+  _lanes[_current].pop();
+  _stats[_current].sent++;
+  _turn = (_current + 1) % DE1_QUEUE_NUM_LANES;
+}
+
+bool PluckyCommandQueue::empty() {
+  for (uint8_t i = 0; i < DE1_QUEUE_NUM_LANES; i++) {
+    if (!_lanes[i].empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char *PluckyCommandQueue::laneName(uint8_t lane, char *buf, size_t size) {
+  switch (lane) {
+    case DE1_QUEUE_LANE_OTHER: return "other";
+    case DE1_QUEUE_LANE_USB: return "USB";
+    case DE1_QUEUE_LANE_BLE: return "BLE";
+    case DE1_QUEUE_LANE_WEBSOCKET: return "WS";
+  }
+  snprintf(buf, size, "TCP_%d", lane - DE1_QUEUE_LANE_TCP_BASE);
+  return buf;
+}
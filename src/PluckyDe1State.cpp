@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include "PluckyDe1State.hpp"
+
+PluckyDe1State::PluckyDe1State() {
+  for (int i = 0; i < DE1_NUM_TAGS; i++) {
+    _slots[i].seq.store(0, std::memory_order_relaxed);
+    _slots[i].len = 0;
+  }
+}
+
+void PluckyDe1State::update(const uint8_t *buf, size_t size) {
+  int tag = frameTagIndex(buf, size);
+  if (tag < 0 || size > DE1_STATE_FRAME_SIZE) {
+    return;
+  }
+  Slot &slot = _slots[tag];
+  uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(slot.data, buf, size);
+  slot.len = size;
+  slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+size_t PluckyDe1State::get(int tag, uint8_t *buf) {
+  if (tag < 0 || tag >= DE1_NUM_TAGS) {
+    return 0;
+  }
+  Slot &slot = _slots[tag];
+  uint32_t before, after;
+  size_t len;
+  do {
+    before = slot.seq.load(std::memory_order_acquire);
+    len = slot.len;
+    if (len > DE1_STATE_FRAME_SIZE) {
+      len = 0;  // torn read; the sequence check below will retry
+    }
+    memcpy(buf, slot.data, len);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = slot.seq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  return len;
+}
+
+uint16_t PluckyDe1State::writeSnapshot(PluckyInterface *dest) {
+  uint16_t count = 0;
+  uint8_t frame[DE1_STATE_FRAME_SIZE];
+  for (int tag = 0; tag < DE1_NUM_TAGS; tag++) {
+    size_t len = get(tag, frame);
+    if (len > 0 && dest->writeAll(frame, len)) {
+      count++;
+    }
+  }
+  return count;
+}
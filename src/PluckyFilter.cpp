@@ -0,0 +1,373 @@
+#include <ArduinoSimpleLogging.h>
+#include <esp_system.h>
+#include <string.h>
+
+#include "PluckyFilter.hpp"
+#include "PluckyBridgeTask.hpp"
+
+// Compiled in ahead of any rules from FILTER_RULES_PATH
+static const char builtinRules[] =
+  "* HEAP command heap\n"
+#if ENABLE_DUAL_CORE_BRIDGE
+  "* BRIDGE command bridge\n"
+#endif // ENABLE_DUAL_CORE_BRIDGE
+#if ENABLE_BLE_P05_WORKAROUND
+  // workaround for missing Mk3b wires for P05 secondary flow control.  see config.hpp for details
+  "DE1,USB,BLE {F}00000001 command reinit\n"
+#endif // ENABLE_BLE_P05_WORKAROUND
+  ;
+
+static const char *actionNames[] = { "drop", "rewrite", "tap", "count", "command" };
+static const char *commandNames[] = { "heap", "bridge", "reinit" };
+
+static int lookup(const char *const *names, int count, const char *word, size_t len) {
+  for (int i = 0; i < count; i++) {
+    if (strlen(names[i]) == len && strncasecmp(word, names[i], len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Next whitespace separated word of a line; returns its length and advances *p past it
+static size_t nextWord(const char **p, const char **word) {
+  const char *s = *p;
+  while (*s == ' ' || *s == '\t') {
+    s++;
+  }
+  *word = s;
+  while (*s && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n') {
+    s++;
+  }
+  *p = s;
+  return s - *word;
+}
+
+PluckyFilter::PluckyFilter() {
+  memset(_tables, 0, sizeof(_tables));
+  _tables[0].numNodes = 1;  // the root
+  _tables[1].numNodes = 1;
+  _readers[0].store(0);
+  _readers[1].store(0);
+  _active.store(&_tables[0]);
+}
+
+// The active table, counted as being read until _release()
+PluckyFilter::Table *PluckyFilter::_acquire() {
+  while (true) {
+    Table *table = _active.load();
+    std::atomic<uint16_t> &readers = _readers[table - _tables];
+    readers.fetch_add(1);
+    // Once counted, compile() won't start on this table; if it already has, back off
+    if (_active.load() == table) {
+      return table;
+    }
+    readers.fetch_sub(1);
+  }
+}
+
+void PluckyFilter::_release(Table *table) {
+  _readers[table - _tables].fetch_sub(1);
+}
+
+bool PluckyFilter::_parseRule(const char *line, PluckyFilterRule &rule) {
+  memset(&rule, 0, sizeof(rule));
+  const char *p = line;
+  const char *word;
+  size_t len = nextWord(&p, &word);
+  if (len == 0 || word[0] == '#') {
+    return false;
+  }
+
+  // Sources
+  if (len == 1 && word[0] == '*') {
+    rule.sources = 0xFF;
+  } else {
+    const char *end = word + len;
+    while (word < end) {
+      const char *comma = (const char *)memchr(word, ',', end - word);
+      size_t nameLen = (comma ? comma : end) - word;
+      int id = PluckyRouter::endpointId(word, nameLen);
+      if (id < 0) {
+        Logger.warning.printf("WARNING: Filter rule has unknown source %.*s: %s", (int)nameLen, word, line);
+        return false;
+      }
+      rule.sources |= ROUTE_BIT(id);
+      word += nameLen + (comma ? 1 : 0);
+    }
+  }
+
+  // Prefix
+  len = nextWord(&p, &word);
+  if (len == 0 || len >= FILTER_PATTERN_SIZE) {
+    Logger.warning.printf("WARNING: Filter rule prefix missing or longer than %d: %s", FILTER_PATTERN_SIZE - 1, line);
+    return false;
+  }
+  memcpy(rule.pattern, word, len);
+  rule.patternLen = len;
+
+  // Action and its argument
+  len = nextWord(&p, &word);
+  int action = lookup(actionNames, sizeof(actionNames) / sizeof(actionNames[0]), word, len);
+  if (action < 0) {
+    Logger.warning.printf("WARNING: Filter rule has unknown action %.*s: %s", (int)len, word, line);
+    return false;
+  }
+  rule.action = action;
+  len = nextWord(&p, &word);
+  int target = 0;
+  switch (action) {
+    case FILTER_ACTION_REWRITE:
+      if (len >= FILTER_ARG_SIZE) {
+        Logger.warning.printf("WARNING: Filter rewrite longer than %d: %s", FILTER_ARG_SIZE - 1, line);
+        return false;
+      }
+      memcpy(rule.arg, word, len);
+      rule.argLen = len;
+      break;
+    case FILTER_ACTION_TAP:
+      target = PluckyRouter::endpointId(word, len);
+      break;
+    case FILTER_ACTION_COMMAND:
+      target = lookup(commandNames, sizeof(commandNames) / sizeof(commandNames[0]), word, len);
+      break;
+  }
+  if (target < 0) {
+    Logger.warning.printf("WARNING: Filter rule has unknown %s target %.*s: %s", actionNames[action], (int)len, word, line);
+    return false;
+  }
+  rule.target = target;
+  return true;
+}
+
+static inline uint16_t edgeSlot(uint16_t parent, uint8_t c) {
+  return (uint16_t)((parent * 31 + c) & (FILTER_EDGE_SLOTS - 1));
+}
+
+uint16_t PluckyFilter::_child(const Table &table, uint16_t parent, uint8_t c) {
+  for (uint16_t slot = edgeSlot(parent, c); ; slot = (slot + 1) & (FILTER_EDGE_SLOTS - 1)) {
+    uint16_t node = table.edges[slot];
+    if (node == 0 || (table.nodes[node].parent == parent && table.nodes[node].c == c)) {
+      return node;
+    }
+  }
+}
+
+bool PluckyFilter::_insert(Table &table, uint8_t index) {
+  const PluckyFilterRule &rule = table.rules[index];
+  uint16_t node = 0;
+  for (uint8_t i = 0; i < rule.patternLen; i++) {
+    uint8_t c = rule.pattern[i];
+    uint16_t child = _child(table, node, c);
+    if (child == 0) {
+      if (table.numNodes >= FILTER_MAX_NODES) {
+        return false;
+      }
+      child = table.numNodes++;
+      table.nodes[child].parent = node;
+      table.nodes[child].c = c;
+      uint16_t slot = edgeSlot(node, c);
+      while (table.edges[slot]) {
+        slot = (slot + 1) & (FILTER_EDGE_SLOTS - 1);
+      }
+      table.edges[slot] = child;
+    }
+    node = child;
+  }
+  table.nodes[node].rules |= (1UL << index);
+  return true;
+}
+
+// Returns the number of lines that held a rule but could not be added, listing them on
+// rejects if given
+int PluckyFilter::_addRules(Table &table, const char *rules, Print *rejects) {
+  int rejected = 0;
+  int lineNumber = 0;
+  const char *line = rules;
+  while (line && *line) {
+    const char *eol = strchr(line, '\n');
+    size_t lineLen = eol ? (size_t)(eol - line + 1) : strlen(line);
+    char buf[128];
+    if (lineLen >= sizeof(buf)) {
+      lineLen = sizeof(buf) - 1;
+    }
+    memcpy(buf, line, lineLen);
+    buf[lineLen] = 0;
+    line = eol ? eol + 1 : NULL;
+    lineNumber++;
+
+    const char *p = buf;
+    const char *word;
+    if (nextWord(&p, &word) == 0 || word[0] == '#') {
+      continue;
+    }
+    uint8_t index = table.numRules;
+    bool added = false;
+    if (table.numRules >= FILTER_MAX_RULES) {
+      Logger.warning.printf("WARNING: More than %d filter rules, ignoring: %s", FILTER_MAX_RULES, buf);
+    } else if (_parseRule(buf, table.rules[index])) {
+      added = _insert(table, index);
+      if (!added) {
+        Logger.warning.printf("WARNING: Filter rule does not fit in the table: %s", buf);
+      }
+    }
+    if (!added) {
+      rejected++;
+      if (rejects) {
+        rejects->printf("line %d: %s%s", lineNumber, buf, eol ? "" : "\n");
+      }
+      continue;
+    }
+    for (uint8_t s = 0; s < ROUTE_NUM_ENDPOINTS; s++) {
+      if (table.rules[index].sources & ROUTE_BIT(s)) {
+        table.sourceRules[s] |= (1UL << index);
+      }
+    }
+    table.numRules++;
+  }
+  return rejected;
+}
+
+// The table not in use, emptied once no run() is left on it
+PluckyFilter::Table &PluckyFilter::_clearInactive() {
+  Table &table = (_active.load() == &_tables[0]) ? _tables[1] : _tables[0];
+  // A run() on another core may have picked this table up just before the last switch
+  while (_readers[&table - _tables].load() != 0) {
+    delay(1);
+  }
+  memset(&table, 0, sizeof(table));
+  table.numNodes = 1;
+  return table;
+}
+
+int PluckyFilter::check(const char *rules, Print &out) {
+  Table &table = _clearInactive();
+  _addRules(table, builtinRules);
+  return _addRules(table, rules, &out);
+}
+
+int PluckyFilter::compile(const char *rules) {
+  Table &table = _clearInactive();
+  _addRules(table, builtinRules);
+  _addRules(table, rules);
+  _active.store(&table);
+  Logger.info.printf("Filter compiled: %d rules, %d trie nodes\n", table.numRules, table.numNodes - 1);
+  return table.numRules;
+}
+
+void PluckyFilter::_runCommand(const PluckyFilterRule &rule, const uint8_t *buf, uint16_t len, const char *interfaceName) {
+  extern bool de1Initialized;
+  switch (rule.target) {
+    case FILTER_COMMAND_HEAP:
+      Logger.info.printf("Free Heap: %d\n", esp_get_free_heap_size());
+      break;
+    case FILTER_COMMAND_BRIDGE:
+#if ENABLE_DUAL_CORE_BRIDGE
+      bridgeTaskPrintStats(Logger.info);
+#endif // ENABLE_DUAL_CORE_BRIDGE
+      break;
+    case FILTER_COMMAND_REINIT:
+      Logger.info.printf("Dropped %.*s from interface %s and re-initializing the DE1.\n", (int)(len - 1), buf, interfaceName);
+      de1Initialized = false;
+      break;
+  }
+}
+
+uint16_t PluckyFilter::run(uint8_t source, uint8_t *buf, uint16_t len, const char *interfaceName, PluckyInterfaceStats &stats) {
+  Table *table = _acquire();
+  len = _run(*table, source, buf, len, interfaceName, stats);
+  _release(table);
+  return len;
+}
+
+uint16_t PluckyFilter::_run(Table &table, uint8_t source, uint8_t *buf, uint16_t len, const char *interfaceName, PluckyInterfaceStats &stats) {
+  if (len >= 2 && buf[len-1] == '\n' && buf[len-2] == '\r') {
+    // convert CRLF to CR just to make everyone's lives easier
+    // but also log a complaint about it
+    buf[len-2] = '\n';
+    len = len-1;
+    stats.crlfFixes++;
+    Logger.warning.printf("WARNING: Stripped CRLF from interface %s\n", interfaceName);
+  }
+  if (len < READ_BUFFER_SIZE) {
+    buf[len] = 0; // force null termination for convenience
+  }
+
+  // One walk down the trie collects every rule whose prefix the frame starts with
+  uint32_t matched = 0;
+  uint16_t node = 0;
+  for (uint16_t i = 0; i < len; i++) {
+    node = _child(table, node, buf[i]);
+    if (node == 0) {
+      break;
+    }
+    matched |= table.nodes[node].rules;
+  }
+  matched &= table.sourceRules[source];
+
+  while (matched) {
+    int index = __builtin_ctz(matched);
+    matched &= matched - 1;
+    PluckyFilterRule &rule = table.rules[index];
+    rule.hits++;
+    switch (rule.action) {
+      case FILTER_ACTION_DROP:
+        stats.filterDrops++;
+        return 0;
+      case FILTER_ACTION_COMMAND:
+        _runCommand(rule, buf, len, interfaceName);
+        stats.filterDrops++;
+        return 0;
+      case FILTER_ACTION_REWRITE:
+        if (len - rule.patternLen + rule.argLen < READ_BUFFER_SIZE) {
+          memmove(buf + rule.argLen, buf + rule.patternLen, len - rule.patternLen);
+          memcpy(buf, rule.arg, rule.argLen);
+          len = len - rule.patternLen + rule.argLen;
+          buf[len] = 0;
+        }
+        break;
+      case FILTER_ACTION_TAP: {
+        extern PluckyRouter router;
+        PluckyInterface *tap = router.getEndpoint(rule.target);
+        if (tap) {
+          tap->writeAll(buf, len);
+        }
+        break;
+      }
+      case FILTER_ACTION_COUNT:
+        break;
+    }
+  }
+  return len;
+}
+
+void PluckyFilter::printRules(Print &out) {
+  Table *table = _acquire();
+  out.printf("# %d rules (built-in first), %d trie nodes\n", table->numRules, table->numNodes - 1);
+  for (uint8_t i = 0; i < table->numRules; i++) {
+    const PluckyFilterRule &rule = table->rules[i];
+    char sources[32] = "";
+    if (rule.sources == 0xFF) {
+      strcpy(sources, "*");
+    } else {
+      for (uint8_t s = 0; s < ROUTE_NUM_ENDPOINTS; s++) {
+        if (rule.sources & ROUTE_BIT(s)) {
+          if (sources[0]) {
+            strcat(sources, ",");
+          }
+          strcat(sources, PluckyRouter::endpointName(s));
+        }
+      }
+    }
+    const char *arg = "";
+    if (rule.action == FILTER_ACTION_REWRITE) {
+      arg = rule.arg;
+    } else if (rule.action == FILTER_ACTION_TAP) {
+      arg = PluckyRouter::endpointName(rule.target);
+    } else if (rule.action == FILTER_ACTION_COMMAND) {
+      arg = commandNames[rule.target];
+    }
+    out.printf("%s %s %s%s%s  # %u hits\n", sources, rule.pattern, actionNames[rule.action], arg[0] ? " " : "", arg, rule.hits);
+  }
+  _release(table);
+}
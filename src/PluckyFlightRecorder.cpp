@@ -0,0 +1,59 @@
+#include <Arduino.h>
+
+#include "PluckyFlightRecorder.hpp"
+
+PluckyFlightRecorder::PluckyFlightRecorder() : _next(0), _frozen(false) {
+  memset(_records, 0, sizeof(_records));
+}
+
+void PluckyFlightRecorder::record(uint8_t source, uint8_t dest, const uint8_t *buf, size_t len) {
+  if (_frozen.load(std::memory_order_relaxed)) {
+    return;
+  }
+  uint32_t seq = _next.fetch_add(1, std::memory_order_relaxed);
+  PluckyTraceRecord &r = _records[seq & (TRACE_NUM_RECORDS - 1)];
+  r.timestampUs = micros();
+  r.source = source;
+  r.dest = dest;
+  r.len = (len > 255) ? 255 : len;
+  r.flags = 0;
+  if (len > TRACE_PAYLOAD_SIZE) {
+    len = TRACE_PAYLOAD_SIZE;
+    r.flags |= TRACE_FLAG_TRUNCATED;
+  }
+  memcpy(r.payload, buf, len);
+  memset(r.payload + len, 0, TRACE_PAYLOAD_SIZE - len);
+  // Written last, so a record caught half-written by a download has a stale seq
+  r.seq = seq;
+}
+
+size_t PluckyFlightRecorder::traceSize() {
+  uint32_t total = _next.load(std::memory_order_acquire);
+  uint32_t numRecords = (total < TRACE_NUM_RECORDS) ? total : TRACE_NUM_RECORDS;
+  return sizeof(PluckyTraceHeader) + numRecords * sizeof(PluckyTraceRecord);
+}
+
+void PluckyFlightRecorder::writeTrace(void (*sink)(const uint8_t *buf, size_t len, void *ctx), void *ctx) {
+  uint32_t total = _next.load(std::memory_order_acquire);
+  uint32_t numRecords = (total < TRACE_NUM_RECORDS) ? total : TRACE_NUM_RECORDS;
+
+  PluckyTraceHeader header;
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.recordSize = sizeof(PluckyTraceRecord);
+  header.numRecords = numRecords;
+  header.totalRecorded = total;
+  header.nowUs = micros();
+  sink((const uint8_t *)&header, sizeof(header), ctx);
+
+  // Oldest record first: once the ring has wrapped that is the one the next frame would overwrite
+  uint32_t oldest = (total - numRecords) & (TRACE_NUM_RECORDS - 1);
+  uint32_t firstSpan = TRACE_NUM_RECORDS - oldest;
+  if (firstSpan > numRecords) {
+    firstSpan = numRecords;
+  }
+  sink((const uint8_t *)&_records[oldest], firstSpan * sizeof(PluckyTraceRecord), ctx);
+  if (numRecords > firstSpan) {
+    sink((const uint8_t *)&_records[0], (numRecords - firstSpan) * sizeof(PluckyTraceRecord), ctx);
+  }
+}
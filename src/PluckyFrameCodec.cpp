@@ -0,0 +1,138 @@
+#include <string.h>
+
+#include "PluckyFrameCodec.hpp"
+
+// Byte -> two uppercase hex digits, the way the DE1 writes them
+static const char hexEncode[513] =
+  "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+  "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+  "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+  "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+  "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+  "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+  "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+  "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Hex digit (either case) -> nibble, 0xFF for anything else
+static const uint8_t hexDecode[256] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+     0,    1,    2,    3,    4,    5,    6,    7,    8,    9, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF,   10,   11,   12,   13,   14,   15, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF,   10,   11,   12,   13,   14,   15, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static size_t packText(const uint8_t *prefix, size_t prefixLen, const uint8_t *ascii, size_t len, uint8_t *out) {
+  if (len > 0 && ascii[len - 1] == '\n') {
+    len--;
+  }
+  size_t packedLen = 1 + prefixLen + len;
+  if (packedLen > PACKED_FRAME_MAX_SIZE - 1) {
+    return 0;
+  }
+  out[0] = packedLen;
+  out[1] = PACKED_KIND_TEXT;
+  if (prefixLen) {
+    memcpy(&out[2], prefix, prefixLen);
+  }
+  memcpy(&out[2 + prefixLen], ascii, len);
+  return 1 + packedLen;
+}
+
+size_t packFrame(const uint8_t *prefix, size_t prefixLen, const uint8_t *ascii, size_t len, uint8_t *out) {
+  // Shortest packable frame is "[X]\n"
+  if (prefixLen > 0 || len < 4 || ascii[len - 1] != '\n') {
+    return packText(prefix, prefixLen, ascii, len, out);
+  }
+  uint8_t close;
+  if (ascii[0] == '[') {
+    close = ']';
+  } else if (ascii[0] == '<') {
+    close = '>';
+  } else {
+    return packText(prefix, prefixLen, ascii, len, out);
+  }
+  size_t hexLen = len - 4;
+  if (ascii[2] != close || (hexLen & 1)) {
+    return packText(prefix, prefixLen, ascii, len, out);
+  }
+
+  const uint8_t *hex = &ascii[3];
+  uint8_t *data = &out[3];
+  for (size_t i = 0; i < hexLen; i += 2) {
+    uint8_t hi = hexDecode[hex[i]];
+    uint8_t lo = hexDecode[hex[i + 1]];
+    if ((hi | lo) & 0xF0) {
+      return packText(prefix, prefixLen, ascii, len, out);
+    }
+    *data++ = (hi << 4) | lo;
+  }
+  out[0] = 2 + hexLen / 2;
+  out[1] = ascii[0];
+  out[2] = ascii[1];
+  return 1 + out[0];
+}
+
+size_t unpackFrame(const uint8_t *packed, size_t len, uint8_t *out, size_t outSize) {
+  if (len < 2 || packed[0] != len - 1) {
+    return 0;
+  }
+  uint8_t kind = packed[1];
+  if (kind == PACKED_KIND_TEXT) {
+    size_t textLen = len - 2;
+    if (textLen + 1 > outSize) {
+      return 0;
+    }
+    memcpy(out, &packed[2], textLen);
+    out[textLen] = '\n';
+    return textLen + 1;
+  }
+
+  uint8_t close;
+  if (kind == '[') {
+    close = ']';
+  } else if (kind == '<') {
+    close = '>';
+  } else {
+    return 0;
+  }
+  if (len < 3) {
+    return 0;
+  }
+  size_t dataLen = len - 3;
+  size_t asciiLen = 3 + 2 * dataLen + 1;
+  if (asciiLen > outSize) {
+    return 0;
+  }
+  out[0] = kind;
+  out[1] = packed[2];
+  out[2] = close;
+  char *hex = (char *)&out[3];
+  for (size_t i = 0; i < dataLen; i++) {
+    memcpy(hex, &hexEncode[2 * packed[3 + i]], 2);
+    hex += 2;
+  }
+  *hex = '\n';
+  return asciiLen;
+}
+
+int frameTagByte(const uint8_t *ascii, size_t len, uint8_t open, uint8_t tag) {
+  uint8_t close = (open == '<') ? '>' : ']';
+  if (len < 5 || ascii[0] != open || ascii[1] != tag || ascii[2] != close) {
+    return -1;
+  }
+  uint8_t hi = hexDecode[ascii[3]];
+  uint8_t lo = hexDecode[ascii[4]];
+  return ((hi | lo) & 0xF0) ? -1 : (hi << 4) | lo;
+}
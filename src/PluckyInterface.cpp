@@ -1,26 +1,38 @@
-#include <ArduinoSimpleLogging.h>
-#include <esp_system.h>
-
 #include "PluckyInterface.hpp"
+#include "PluckyBootTimeline.hpp"
+#include "PluckyDe1State.hpp"
+#include "PluckyFilter.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyRouter.hpp"
+#include "PluckyShotRecorder.hpp"
 
-void trimBuffer(uint8_t *buf, uint16_t &len, char *interfaceName) {
-  if (buf[len-1] == '\n') {
-    if (buf[len-2] == '\r') {
-      // convert CRLF to CR just to make everyone's lives easier
-      // but also log a complaint about it
-      buf[len-2] = '\n';
-      len = len-1;
-      Logger.warning.printf("WARNING: Stripped CRLF from interface %s\n", interfaceName);
-    }
+void PluckyInterface::_receiveFrame(uint8_t routeId, uint8_t traceId, uint8_t lane, const char *prefix, size_t prefixLen,
+                                    uint8_t *frame, uint16_t len, bool recordShot) {
+  _stats.framesIn++;
+  if (_stats.framesIn == 1 && routeId == ROUTE_DE1) {
+    bootMilestone("first DE1 frame");
   }
-  if (len < READ_BUFFER_SIZE) {
-    buf[len] = 0; // force null termination for convenience
+  extern PluckyFlightRecorder flightRecorder;
+  flightRecorder.record(traceId, (routeId == ROUTE_DE1) ? TRACE_ID_CONTROLLERS : TRACE_ID_DE1, frame, len);
+  // CRLF cleanup, local commands, the P05 workaround and any site rules
+  extern PluckyFilter frameFilter;
+  len = frameFilter.run(routeId, frame, len, getName(), _stats);
+  if (len == 0) {
+    return;
   }
-}
 
-void debugHandler(uint8_t *buf, uint16_t &len) {
-  if (strncmp((char *)buf, "HEAP", 4) == 0) {
-    Logger.info.printf("Free Heap: %d\n", esp_get_free_heap_size());
-    len=0;
+  if (routeId == ROUTE_DE1) {
+    // Remember it for clients that connect later
+    extern PluckyDe1State de1State;
+    de1State.update(frame, len);
+    if (recordShot) {
+      // Staged in RAM during a shot; the shot store's writer task puts it on flash
+      extern PluckyShotRecorder shotRecorder;
+      shotRecorder.record(frame, len);
+    }
   }
+
+  // DE1 frames go to the controllers, controller frames to the DE1 (see PluckyRouter)
+  extern PluckyRouter router;
+  router.dispatch(routeId, lane, (const uint8_t *)prefix, prefixLen, frame, len);
 }
@@ -0,0 +1,83 @@
+#include <ArduinoSimpleLogging.h>
+
+#include "PluckyInterfaceCrossCore.hpp"
+#include "PluckyBridgeTask.hpp"
+
+#if ENABLE_DUAL_CORE_BRIDGE
+
+PluckyInterfaceCrossCore::PluckyInterfaceCrossCore(PluckyInterface *wrapped) {
+  _wrapped = wrapped;
+  _drops = 0;
+  snprintf(_name, sizeof(_name), "%s_crosscore", wrapped->getName());
+}
+
+PluckyInterfaceCrossCore::~PluckyInterfaceCrossCore() {
+}
+
+void PluckyInterfaceCrossCore::doInit() {
+  _wrapped->doInit();
+}
+
+void PluckyInterfaceCrossCore::doLoop() {
+  // Replay what the bridge task queued for us, then let the wrapped interface run
+  size_t len;
+  const uint8_t *frame;
+  while ((frame = _fromBridge.front(&len)) != NULL) {
+    _wrapped->writeAll(frame, len);
+    _fromBridge.pop();
+  }
+  _wrapped->doLoop();
+}
+
+void PluckyInterfaceCrossCore::visitStats(PluckyStatsVisitor fn, void *ctx) {
+  _wrapped->visitStats(fn, ctx);
+  fn(getName(), _stats, ctx);
+}
+
+void PluckyInterfaceCrossCore::begin() {
+  _wrapped->begin();
+}
+
+void PluckyInterfaceCrossCore::end() {
+  _wrapped->end();
+}
+
+bool PluckyInterfaceCrossCore::available() {
+  return _wrapped->available();
+}
+
+bool PluckyInterfaceCrossCore::readAll() {
+  return _wrapped->readAll();
+}
+
+bool PluckyInterfaceCrossCore::availableForWrite(size_t len) {
+  return _wrapped->availableForWrite(len);
+}
+
+bool PluckyInterfaceCrossCore::writeAll(const uint8_t *buf, size_t size) {
+  if (!inBridgeTask()) {
+    return _wrapped->writeAll(buf, size);
+  }
+  return writeAllPrefixed(NULL, 0, buf, size);
+}
+
+bool PluckyInterfaceCrossCore::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+  if (!inBridgeTask()) {
+    return _wrapped->writeAllPrefixed(prefix, prefixSize, buf, size);
+  }
+  if (size == 0) {
+    return false;
+  }
+  if (!_fromBridge.push(prefix, prefixSize, buf, size)) {
+    // loop() is badly behind; drop rather than stall the UARTs.  Don't log from here
+    // on every frame, the bridge task would spend its time printing.
+    _stats.writeDrops++;
+    if ((_drops++ % 100) == 0) {
+      Logger.warning.printf("WARNING: Cross-core queue full, %u frames dropped so far\n", _drops);
+    }
+    return false;
+  }
+  return true;
+}
+
+#endif // ENABLE_DUAL_CORE_BRIDGE
@@ -0,0 +1,231 @@
+#include <Arduino.h>
+#include <ArduinoSimpleLogging.h>
+#include <stdlib.h>
+
+#include "PluckyInterfaceDe1Sim.hpp"
+#include "PluckyCommandQueue.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyFrameCodec.hpp"
+#include "PluckyRouter.hpp"
+#include "PluckyBridgeTask.hpp"
+#include "PluckyShotRecorder.hpp"
+#include "config.hpp"
+
+PluckyInterfaceDe1Sim::PluckyInterfaceDe1Sim() : _requested(-1), _shotLoaded(false) {
+  _loadedRecords = NULL;
+  _loadedLen = 0;
+  _records = NULL;
+  _recordsLen = 0;
+  _synthetic = NULL;
+  _pos = 0;
+  _playing = false;
+  _playStartMs = 0;
+  _playedMs = 0;
+  _state = DE1_STATE_IDLE;
+  _sleepPending = false;
+  _sleepAtMs = 0;
+  _speed = 1;
+  _repeat = false;
+  _replays = 0;
+  _promiscuousPrefix[0] = 0;
+  _promiscuousPrefixLen = 0;
+}
+
+PluckyInterfaceDe1Sim::~PluckyInterfaceDe1Sim() {
+  free(_synthetic);
+}
+
+void PluckyInterfaceDe1Sim::doInit() {
+  if (!_records && !_shotLoaded.load()) {
+    _buildSyntheticShot();
+  }
+  begin();
+}
+
+void PluckyInterfaceDe1Sim::doLoop() {
+  readAll();
+}
+
+void PluckyInterfaceDe1Sim::begin() {
+  _promiscuousPrefixLen = sprintf(_promiscuousPrefix, "{%s} ", getName());
+  Logger.info.printf("Started interface %s (simulated DE1, %u bytes of shot to replay)\n", getName(), (unsigned)_recordsLen);
+}
+
+void PluckyInterfaceDe1Sim::end() {
+  _playing = false;
+  _sleepPending = false;
+}
+
+bool PluckyInterfaceDe1Sim::available() {
+  return _playing || _sleepPending || _requested.load() >= 0 || _shotLoaded.load();
+}
+
+bool PluckyInterfaceDe1Sim::load(const uint8_t *data, size_t len) {
+  PluckyShotHeader header;
+  if (len < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.magic != SHOT_MAGIC || header.headerSize < sizeof(header) || header.headerSize > len) {
+    return false;
+  }
+  // Up to the trailer, or the last whole record of a recording that was cut short
+  size_t pos = header.headerSize;
+  while (pos + 3 <= len && (data[pos] | (data[pos + 1] << 8)) != SHOT_TRAILER_MARK && pos + 3 + data[pos + 2] <= len) {
+    pos += 3 + data[pos + 2];
+  }
+  if (pos == header.headerSize) {
+    return false;
+  }
+  _loadedRecords = data + header.headerSize;
+  _loadedLen = pos - header.headerSize;
+  _shotLoaded.store(true, std::memory_order_release);
+  Logger.info.printf("Simulated DE1 will replay shot %u (%u bytes)\n", header.shotNumber, (unsigned)_loadedLen);
+  return true;
+}
+
+// A plain 9 bar shot: pressure ramps up over 8 s, holds and tails off, as [M] samples.
+// Going back to Idle at the end is left to _play().
+void PluckyInterfaceDe1Sim::_buildSyntheticShot() {
+  const uint32_t samples = DE1_SIM_SYNTH_SHOT_MS / DE1_SIM_SYNTH_SAMPLE_MS + 1;
+  // 2 byte delta + 22 byte packed sample each
+  _synthetic = (uint8_t *)malloc(samples * 24);
+  if (!_synthetic) {
+    return;
+  }
+  size_t len = 0;
+  char ascii[64];
+  for (uint32_t i = 0; i < samples; i++) {
+    uint32_t t = i * DE1_SIM_SYNTH_SAMPLE_MS;
+    // Fixed point as the DE1 sends it: pressure and flow in 1/4096, temperatures in 1/256
+    uint32_t pressure = (t < 8000) ? 9 * 4096 * t / 8000 :
+                        (t < 22000) ? 9 * 4096 : 9 * 4096 - 3 * 4096 * (t - 22000) / 8000;
+    uint32_t flow = (t < 4000) ? 4 * 4096 :
+                    (t < 8000) ? 4 * 4096 - 2 * 4096 * (t - 4000) / 4000 : 2 * 4096 + 2048 * (t - 8000) / 22000;
+    snprintf(ascii, sizeof(ascii), "[M]%04X%04X%04X%04X%06X%04X%04X%02X%02X%02X%02X\n",
+             (unsigned)((t / 10) & 0xFFFF), (unsigned)pressure, (unsigned)flow, 92 * 256, 93 * 65536,
+             92 * 256, 93 * 256, 9 * 16, 0, (t < 8000) ? 0 : 1, 150);
+    uint32_t delta = (i == 0) ? 0 : DE1_SIM_SYNTH_SAMPLE_MS;
+    _synthetic[len] = delta & 0xFF;
+    _synthetic[len + 1] = delta >> 8;
+    len += 2 + packFrame(NULL, 0, (const uint8_t *)ascii, strlen(ascii), &_synthetic[len + 2]);
+  }
+  _records = _synthetic;
+  _recordsLen = len;
+}
+
+bool PluckyInterfaceDe1Sim::writeAll(const uint8_t *buf, size_t size) {
+  return writeAllPrefixed(NULL, 0, buf, size);
+}
+
+bool PluckyInterfaceDe1Sim::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+  _stats.framesOut++;
+  _stats.bytesOut += prefixSize + size;
+  // Promiscuous copies of other interfaces' traffic are not commands
+  int state = prefixSize ? -1 : frameTagByte(buf, size, '<', 'B');
+  if (state >= 0) {
+    _requested.store(state);
+#if ENABLE_DUAL_CORE_BRIDGE
+    bridgeTaskWake();  // act on it now rather than at the next tick
+#endif // ENABLE_DUAL_CORE_BRIDGE
+  }
+  return true;
+}
+
+bool PluckyInterfaceDe1Sim::readAll() {
+  uint32_t framesBefore = _stats.framesIn;
+  uint32_t now = millis();
+  if (!_playing && _shotLoaded.exchange(false, std::memory_order_acquire)) {
+    free(_synthetic);
+    _synthetic = NULL;
+    _records = _loadedRecords;
+    _recordsLen = _loadedLen;
+  }
+  int16_t requested = _requested.exchange(-1);
+  if (requested >= 0) {
+    _request(requested, now);
+  }
+  if (_sleepPending && now - _sleepAtMs >= DE1_SIM_SLEEP_DELAY_MS) {
+    _sleepPending = false;
+    _enterState(DE1_STATE_SLEEP);
+  }
+  if (_playing) {
+    _play(now);
+  }
+  return _stats.framesIn != framesBefore;
+}
+
+void PluckyInterfaceDe1Sim::_request(uint8_t state, uint32_t now) {
+  if (state == _state || (state == DE1_STATE_SLEEP && _sleepPending)) {
+    return;
+  }
+  _playing = false;
+  _sleepPending = false;
+  if (state == DE1_STATE_SLEEP) {
+    _enterState(DE1_STATE_GOING_TO_SLEEP);
+    _sleepPending = true;
+    _sleepAtMs = now;
+    return;
+  }
+  _enterState(state);
+  if (state != DE1_STATE_ESPRESSO) {
+    return;
+  }
+  if (_recordsLen == 0) {
+    // Nothing to pour (the built-in shot could not be allocated): the shot is over at once
+    Logger.warning.printf("WARNING: %s has no shot to replay\n", getName());
+    _enterState(DE1_STATE_IDLE);
+    return;
+  }
+  _playing = true;
+  _pos = 0;
+  _playStartMs = now;
+  _playedMs = 0;
+}
+
+void PluckyInterfaceDe1Sim::_enterState(uint8_t state) {
+  _state = state;
+  _emit(sprintf((char *)_readBuf, "[N]%02X00\n", state));
+}
+
+// Sends the records that are due, at most DE1_SIM_BURST of them
+void PluckyInterfaceDe1Sim::_play(uint32_t now) {
+  for (int sent = 0; sent < DE1_SIM_BURST; sent++) {
+    if (_pos >= _recordsLen) {
+      _replays++;
+      if (!_repeat) {
+        _playing = false;
+        if (_state == DE1_STATE_ESPRESSO) {
+          _enterState(DE1_STATE_IDLE);
+        }
+        return;
+      }
+      _pos = 0;
+      _playStartMs = now;
+      _playedMs = 0;
+    }
+    uint32_t delta = _records[_pos] | (_records[_pos + 1] << 8);
+    if (_speed && (uint64_t)(now - _playStartMs) * _speed < _playedMs + delta) {
+      return;
+    }
+    _playedMs += delta;
+    const uint8_t *packed = &_records[_pos + 2];
+    _pos += 3 + packed[0];
+    size_t len = unpackFrame(packed, 1 + packed[0], _readBuf, sizeof(_readBuf));
+    if (len == 0) {
+      continue;
+    }
+    int state = frameTagByte(_readBuf, len, '[', 'N');
+    if (state >= 0) {
+      _state = state;
+    }
+    _emit(len);
+  }
+}
+
+// Sends the frame in _readBuf on, as PluckyInterfaceSerial does a frame from the DE1 UART
+void PluckyInterfaceDe1Sim::_emit(size_t len) {
+  _stats.bytesIn += len;
+  _receiveFrame(ROUTE_DE1, TRACE_ID_DE1, DE1_QUEUE_LANE_OTHER, _promiscuousPrefix, _promiscuousPrefixLen,
+                _readBuf, len, DE1_SIM_RECORD_SHOTS);
+}
@@ -5,32 +5,60 @@
 PluckyInterfaceGroup::PluckyInterfaceGroup(uint8_t numInterfaces) {
     _numInterfaces = numInterfaces;
     _interfaces = new PluckyInterface *[numInterfaces];
+    // Slots may be filled in later (see startNetworkInterfaces()); until then they are
+    // skipped, which needs them to start out NULL
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        _interfaces[i] = NULL;
+    }
+    _loopHistograms = new PluckyLatencyHistogram[numInterfaces];
 }
 
 PluckyInterfaceGroup::~PluckyInterfaceGroup() {
-    delete _interfaces;    
+    delete[] _interfaces;
+    delete[] _loopHistograms;
 }
 
 void PluckyInterfaceGroup::doInit() {
     for (uint16_t i=0; i<_numInterfaces; i++) {
+        initChild(i);
+    }
+}
+
+void PluckyInterfaceGroup::initChild(uint16_t i) {
+    if (_interfaces[i]) {
         _interfaces[i]->doInit();
     }
+#if ENABLE_LOOP_PROFILER
+    char name[PROFILER_NAME_SIZE];
+    _childName(i, name, sizeof(name));
+    profilerRegister(name, &_loopHistograms[i]);
+#endif // ENABLE_LOOP_PROFILER
 }
 
 void PluckyInterfaceGroup::doLoop() {
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        _interfaces[i]->doLoop();
+        if (_interfaces[i]) {
+            _loopChild(i);
+        }
     }
 }
 
+void PluckyInterfaceGroup::_childName(uint16_t i, char *buf, size_t size) {
+    snprintf(buf, size, "%s", _interfaces[i] ? _interfaces[i]->getName() : "[empty]");
+}
+
 void PluckyInterfaceGroup::begin() {
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        _interfaces[i]->begin();
+        if (_interfaces[i]) {
+            _interfaces[i]->begin();
+        }
     }   
 }
 void PluckyInterfaceGroup::end(){
-        for (uint16_t i=0; i<_numInterfaces; i++) {
-        _interfaces[i]->end();
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            _interfaces[i]->end();
+        }
     }
 }
 
@@ -38,7 +66,7 @@ bool PluckyInterfaceGroup::available() {
     // Note, because readAll() visits and reads ALL interfaces in the group
     // this does not introduce a bias / risk of starvation.
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        if (_interfaces[i]->available()) {
+        if (_interfaces[i] && _interfaces[i]->available()) {
             return true;
         }
     }
@@ -48,7 +76,7 @@ bool PluckyInterfaceGroup::available() {
 bool PluckyInterfaceGroup::readAll() {
     bool didRead = false;
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        if (_interfaces[i]->available()) {
+        if (_interfaces[i] && _interfaces[i]->available()) {
             didRead = (_interfaces[i]->readAll() || didRead);
         }
     }
@@ -61,7 +89,7 @@ bool PluckyInterfaceGroup::availableForWrite(size_t len) {
     // (leaving it to the leaf interfaces to handle buffering, flushing, closing, etc)
     // this does not introduce a risk of blockage or starvation.
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        if (_interfaces[i]->availableForWrite(len)) {
+        if (_interfaces[i] && _interfaces[i]->availableForWrite(len)) {
             return true;
         }
     }
@@ -71,7 +99,19 @@ bool PluckyInterfaceGroup::availableForWrite(size_t len) {
 bool PluckyInterfaceGroup::writeAll(const uint8_t *buf, size_t size) {
     bool didWrite = false;
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        didWrite = (_interfaces[i]->writeAll(buf, size) || didWrite);
+        if (_interfaces[i]) {
+            didWrite = (_interfaces[i]->writeAll(buf, size) || didWrite);
+        }
+    }
+    return didWrite;
+}
+
+bool PluckyInterfaceGroup::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+    bool didWrite = false;
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            didWrite = (_interfaces[i]->writeAllPrefixed(prefix, prefixSize, buf, size) || didWrite);
+        }
     }
     return didWrite;
 }
@@ -80,3 +120,10 @@ uint8_t PluckyInterfaceGroup::getNumInterfaces() {
     return _numInterfaces;
 }
 
+void PluckyInterfaceGroup::visitStats(PluckyStatsVisitor fn, void *ctx) {
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            _interfaces[i]->visitStats(fn, ctx);
+        }
+    }
+}
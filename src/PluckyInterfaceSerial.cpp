@@ -3,32 +3,51 @@
 #include <ArduinoSimpleLogging.h>
 
 #include "PluckyInterfaceSerial.hpp"
-#include "PluckyInterfaceGroup.hpp"
+#include "PluckyBridgeTask.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyRouter.hpp"
+#include "PluckySettings.hpp"
 #include "config.hpp"
 
-extern char *userSettingStr_bleFlowControl;
-extern char *userSettingStr_tcpPort;
-
-extern bool de1Initialized;
+extern PluckySettings userSettings;
 
 PluckyInterfaceSerial::PluckyInterfaceSerial(int uart_nr) {
     _uart_nr = uart_nr;
-    _readBufIndex = 0;
+    _promiscuousPrefix[0] = 0;
+    _promiscuousPrefixLen = 0;
+    _commands = NULL;
+#if ENABLE_DUAL_CORE_BRIDGE
+    _rxSignalledUs = 0;
+#endif // ENABLE_DUAL_CORE_BRIDGE
     if (uart_nr == SERIAL_USB_UART_NUM) {
         // We are capturing the (open, global, probably USB) terminal Serial so just grab it
         _serial = &Serial;
         sprintf(_interfaceName, "Serial_USB");
+        _traceId = TRACE_ID_USB;
+        _routeId = ROUTE_USB;
+        _commandLane = DE1_QUEUE_LANE_USB;
     } else {
         _serial = new HardwareSerial(uart_nr);
         if (_uart_nr == SERIAL_DE_UART_NUM) {
             sprintf(_interfaceName, "Serial_DE");
+            _traceId = TRACE_ID_DE1;
+            _routeId = ROUTE_DE1;
+            _commandLane = DE1_QUEUE_LANE_OTHER;
+            // Everything bound for the DE1 waits its turn here rather than being dropped
+            _commands = new PluckyCommandQueue();
         } else {
             sprintf(_interfaceName, "Serial_BLE");
+            _traceId = TRACE_ID_BLE;
+            _routeId = ROUTE_BLE;
+            _commandLane = DE1_QUEUE_LANE_BLE;
+            userSettings.subscribe(SETTING_BLE_FLOW_CONTROL, _settingsChanged_CB, this);
         }
     }
 }
 
 PluckyInterfaceSerial::~PluckyInterfaceSerial() {
+    userSettings.unsubscribe(this);
+    delete _commands;
     if (_uart_nr != SERIAL_USB_UART_NUM) {
         delete _serial;
     }
@@ -36,15 +55,27 @@ PluckyInterfaceSerial::~PluckyInterfaceSerial() {
 
 void PluckyInterfaceSerial::doInit() {
     begin();
-    _readBufIndex = 0;
+    _rxRing.clear();
 }
 
 void PluckyInterfaceSerial::doLoop() {
+#if ENABLE_DUAL_CORE_BRIDGE
+    // Send what loop() queued for this UART since we last ran
+    size_t len;
+    const uint8_t *frame;
+    while ((frame = _txFromLoop.front(&len)) != NULL) {
+        writeAll(frame, len);
+        _txFromLoop.pop();
+    }
+#endif // ENABLE_DUAL_CORE_BRIDGE
+    if (_commands) {
+        _drainCommands();
+    }
     readAll();
 }
 
 void PluckyInterfaceSerial::begin() {
-    _readBufIndex = 0;
+    _rxRing.clear();
     if (_uart_nr == SERIAL_USB_UART_NUM) {
         sprintf(_interfaceName, "Serial_USB");
         _serial->begin(UART_BAUD);
@@ -56,22 +87,58 @@ void PluckyInterfaceSerial::begin() {
         sprintf(_interfaceName, "Serial_BLE");
         _serial->begin(UART_BAUD, SERIAL_PARAM, SERIAL_BLE_RX_PIN, SERIAL_BLE_TX_PIN);
         gpio_pullup_en((gpio_num_t)SERIAL_BLE_RX_PIN);  // suppress noise if BLE not attached
-        
-        if (atoi(userSettingStr_bleFlowControl) == 0) {
-            Logger.info.println("BLE HW flow control disabled");
-        } else {
-            Logger.info.println("BLE HW flow control enabled");
-            uart_set_hw_flow_ctrl(SERIAL_BLE_UART_NUM, UART_HW_FLOWCTRL_CTS_RTS, 0);
-            uart_set_pin(SERIAL_BLE_UART_NUM, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, SERIAL_BLE_RTS_PIN, SERIAL_BLE_CTS_PIN);
-            gpio_pulldown_en((gpio_num_t)SERIAL_BLE_CTS_PIN);  // this helps but is inconsistent. (not strong enough vs FTDI reset pullup) 
-        }
+        applyFlowControl();
     }
+#if ENABLE_DUAL_CORE_BRIDGE
+    _beginRxSignal();
+#endif // ENABLE_DUAL_CORE_BRIDGE
+    _promiscuousPrefixLen = sprintf(_promiscuousPrefix, "{%s} ", _interfaceName);
     Logger.info.printf("Started interface %s\n", _interfaceName);
 }
 
+void PluckyInterfaceSerial::applyFlowControl() {
+    if (_uart_nr != SERIAL_BLE_UART_NUM) {
+        return;
+    }
+    if (!userSettings.bleFlowControl) {
+        Logger.info.println("BLE HW flow control disabled");
+        uart_set_hw_flow_ctrl(SERIAL_BLE_UART_NUM, UART_HW_FLOWCTRL_DISABLE, 0);
+        // Hand RTS/CTS back to plain GPIO in case flow control was on until now
+        gpio_reset_pin((gpio_num_t)SERIAL_BLE_RTS_PIN);
+        gpio_reset_pin((gpio_num_t)SERIAL_BLE_CTS_PIN);
+    } else {
+        Logger.info.println("BLE HW flow control enabled");
+        uart_set_hw_flow_ctrl(SERIAL_BLE_UART_NUM, UART_HW_FLOWCTRL_CTS_RTS, 0);
+        uart_set_pin(SERIAL_BLE_UART_NUM, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, SERIAL_BLE_RTS_PIN, SERIAL_BLE_CTS_PIN);
+        gpio_pulldown_en((gpio_num_t)SERIAL_BLE_CTS_PIN);  // this helps but is inconsistent. (not strong enough vs FTDI reset pullup) 
+    }
+}
+
+void PluckyInterfaceSerial::_settingsChanged_CB(uint32_t changed, void *ctx) {
+    ((PluckyInterfaceSerial *)ctx)->applyFlowControl();
+}
+
+#if ENABLE_DUAL_CORE_BRIDGE
+void PluckyInterfaceSerial::_beginRxSignal() {
+    // HardwareSerial runs this from its own UART event task whenever the driver has
+    // received data: at the RX FIFO threshold, or at the RX idle timeout that follows the
+    // end of a frame.  The driver stays HardwareSerial's; we only hear about it.  Arrival
+    // times feed the bridge task's receive-wait counters in both modes, so polled and
+    // event-driven receive can be compared on the same build.
+    _serial->onReceive([this]() {
+        if (_rxSignalledUs == 0) {
+            _rxSignalledUs = micros() | 1;
+        }
+#if ENABLE_UART_EVENT_RX
+        bridgeTaskWake();
+#endif // ENABLE_UART_EVENT_RX
+    });
+}
+#endif // ENABLE_DUAL_CORE_BRIDGE
+
 void PluckyInterfaceSerial::end() {
     _serial->end();
-    _readBufIndex = 0;
+    _rxRing.clear();
 }
 
 bool PluckyInterfaceSerial::available() {
@@ -80,69 +147,162 @@ bool PluckyInterfaceSerial::available() {
 
 bool PluckyInterfaceSerial::readAll() {
     bool didRead = false;
-    while (_serial->available() && _readBufIndex < READ_BUFFER_SIZE) {
-        _readBuf[_readBufIndex] = _serial->read();
-        _readBufIndex++;
-        didRead = true;
-        if (_readBuf[_readBufIndex - 1] == '\n') { 
-            uint16_t sendLen = _readBufIndex;
-            _readBufIndex = 0;
-
-            // received an LF terminator, meaning this message can be dispatched
-            // first, perform some cleanup and handling of the LF terminated string
-            trimBuffer(_readBuf, sendLen, _interfaceName);
-            debugHandler(_readBuf, sendLen);
-#if ENABLE_BLE_P05_WORKAROUND
-            // workaround for missing Mk3b wires for P05 secondary flow control.  see config.hpp  for details
-            if (strncmp((char *)_readBuf, "{F}00000001", 11) == 0) {
-                sendLen = 0;
-                Logger.info.printf("Dropped message enabling (unsupported) P05 BLE flow control from interface %s.\n", _interfaceName);
-                de1Initialized = false;
+    bool draining = true;
+    while (draining) {
+        // Pull everything the UART driver has buffered into the ring with bulk reads,
+        // rather than paying for an available()/read() pair (and driver lock) per byte.
+        int avail = _serial->available();
+        while (avail > 0) {
+            uint8_t *dst;
+            size_t span = _rxRing.writeSpan(&dst);
+            if (span == 0) {
+                break;
+            }
+            size_t got = _serial->read(dst, (span < (size_t)avail) ? span : (size_t)avail);
+            if (got == 0) {
+                break;
             }
-#endif // ENABLE_BLE_P05_WORKAROUND
+            _rxRing.commit(got);
+            _stats.bytesIn += got;
+            avail -= got;
+            didRead = true;
+        }
+        // Only loop around again if the ring filled up before the driver was empty
+        draining = (avail > 0);
+#if ENABLE_DUAL_CORE_BRIDGE
+        uint32_t signalled = _rxSignalledUs;
+        if (didRead && signalled) {
+            _rxSignalledUs = 0;
+            bridgeTaskRecordRxWait(micros() - signalled);
+        }
+#endif // ENABLE_DUAL_CORE_BRIDGE
 
-            if (_uart_nr == SERIAL_DE_UART_NUM) {
-                // Broadcast to all interfaces
-                extern PluckyInterfaceGroup controllers;
-                controllers.writeAll(_readBuf, sendLen);
+        // Dispatch every complete LF-terminated line now sitting in the ring
+        while (!_rxRing.empty()) {
+            int lfIndex = _rxRing.find('\n', READ_BUFFER_SIZE);
+            if (lfIndex >= 0) {
+                uint16_t sendLen = lfIndex + 1;
+                _rxRing.pop(_readBuf, sendLen);
+                _handleFrame(sendLen);
+            } else if (_rxRing.used() >= READ_BUFFER_SIZE) {
+                // If we are receiving messages longer than the buffer, this prevents overflow and/or blocking
+                // Typically this only happens when noise is coming in on the BLE UART, or if baud rates    
+                // are misconfigured, as the buffer size ought to be longer than the maximum DE1 does message length  
+                _rxRing.pop(_readBuf, READ_BUFFER_SIZE);
+                _stats.overruns++;
+                Logger.warning.printf("WARNING: Read Buffer Overrun on interface %s -- purging.\n", _interfaceName);
+                Logger.debug.print("    Buffer contents: ");
+                Logger.debug.write(_readBuf, READ_BUFFER_SIZE);
+                Logger.debug.println();
             } else {
-                // Send to DE
-                extern PluckyInterfaceSerial de1Serial;
-                de1Serial.writeAll(_readBuf, sendLen);
-
-                // Broadcast to all interfaces if promiscuous usersetting is 1
-                // Note we assume that _readBuf is newline- and null-terminated, accomplished by trimBuffer
-                extern char *userSettingStr_promiscuous;
-                if (atoi(userSettingStr_promiscuous) == 1) {
-                    char broadcastMessage[READ_BUFFER_SIZE+strlen(_interfaceName)+4];
-                    sprintf(broadcastMessage, "{%s} %s", _interfaceName, (char *)_readBuf);
-                    extern PluckyInterfaceGroup controllers;
-                    controllers.writeAll((uint8_t *)broadcastMessage, strlen(broadcastMessage));
-                }
-
+                break; // partial line, wait for the rest of it
             }
         }
     }
-    // If we are receiving messages longer than the buffer, this prevents overflow and/or blocking
-    // Typically this only happens when noise is coming in on the BLE UART, or if baud rates    
-    // are misconfigured, as the buffer size ought to be longer than the maximum DE1 does message length  
-    if (_readBufIndex >= READ_BUFFER_SIZE) {
-        Logger.warning.printf("WARNING: Read Buffer Overrun on interface %s -- purging.\n", _interfaceName);
-        Logger.debug.print("    Buffer contents: ");
-        Logger.debug.write(_readBuf, READ_BUFFER_SIZE);
-        Logger.debug.println();
-        _readBufIndex = 0;
-    }
     return didRead;
 }   
 
+void PluckyInterfaceSerial::_handleFrame(uint16_t sendLen) {
+    // received an LF terminator, meaning this message can be dispatched
+    _receiveFrame(_routeId, _traceId, _commandLane, _promiscuousPrefix, _promiscuousPrefixLen, _readBuf, sendLen, true);
+}
+
 bool PluckyInterfaceSerial::availableForWrite(size_t len) {
-    return (_serial->availableForWrite() > len);
+    int avail = _serial->availableForWrite();
+    return (avail >= 0 && (size_t)avail > len);
 }
 
 bool PluckyInterfaceSerial::writeAll(const uint8_t *buf, size_t size) {
+    return writeAllPrefixed(NULL, 0, buf, size);
+}
+
+// False while the bridge task owns this UART and we are on loop()'s core
+bool PluckyInterfaceSerial::_ownsUart() {
+#if ENABLE_DUAL_CORE_BRIDGE
+    return !(bridgeTaskRunning() && !inBridgeTask());
+#else
+    return true;
+#endif // ENABLE_DUAL_CORE_BRIDGE
+}
+
+bool PluckyInterfaceSerial::writeAllFrom(uint8_t sender, const uint8_t *buf, size_t size) {
+    if (!_commands || size >= SERIAL_TX_BUFFER_SIZE) {
+        return writeAll(buf, size);
+    }
+    // Each sender's lane has a single producer, so this is safe from either core
+    if (!_queueCommand(sender, NULL, 0, buf, size)) {
+        return false;
+    }
+    if (_ownsUart()) {
+        _drainCommands();
+    } else {
+        bridgeTaskWake();
+    }
+    return true;
+}
+
+bool PluckyInterfaceSerial::_queueCommand(uint8_t lane, const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+    if (size == 0) {
+        return false;
+    }
+    if (prefixSize + size >= SERIAL_TX_BUFFER_SIZE) {
+        return _ownsUart() && _writeUart(prefix, prefixSize, buf, size);
+    }
+    if (!_commands->push(lane, prefix, prefixSize, buf, size)) {
+        char laneName[16];
+        Logger.warning.printf("WARNING: Interface %s queue for %s full, dropping message\n", _interfaceName, 
+            PluckyCommandQueue::laneName(lane, laneName, sizeof(laneName)));
+        _stats.writeDrops++;
+        return false;
+    }
+    return true;
+}
+
+// Writes queued frames, one sender at a time in turn, for as long as the UART has room
+void PluckyInterfaceSerial::_drainCommands() {
+    size_t len;
+    const uint8_t *frame;
+    while ((frame = _commands->next(&len)) != NULL) {
+        if (_serial->availableForWrite() <= (int)len) {
+            return; // the rest go out as the TX buffer empties
+        }
+        _writeUart(NULL, 0, frame, len);
+        _commands->pop();
+    }
+}
+
+bool PluckyInterfaceSerial::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+#if ENABLE_DUAL_CORE_BRIDGE
+    if (bridgeTaskRunning() && !inBridgeTask()) {
+        // The UART belongs to the bridge task; hand the frame over rather than touching 
+        // the driver from loop()'s core
+        if (size == 0) {
+            return false;
+        }
+        if (!_txFromLoop.push(prefix, prefixSize, buf, size)) {
+            Logger.warning.printf("WARNING: Interface %s cross-core queue full, dropping message\n", _interfaceName);
+            _stats.writeDrops++;
+            return false;
+        }
+        bridgeTaskWake();
+        return true;
+    }
+#endif // ENABLE_DUAL_CORE_BRIDGE
+    if (_commands) {
+        // Unattributed writes to the DE1 queue too, so a burst doesn't lose any
+        if (!_queueCommand(DE1_QUEUE_LANE_OTHER, prefix, prefixSize, buf, size)) {
+            return false;
+        }
+        _drainCommands();
+        return true;
+    }
+    return _writeUart(prefix, prefixSize, buf, size);
+}
+
+bool PluckyInterfaceSerial::_writeUart(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
     bool didWrite = false;
-    if (_serial->availableForWrite() > size) {
+    int avail = _serial->availableForWrite();
+    if (avail >= 0 && (size_t)avail > prefixSize + size) {
         // This if statement is used to prevent blocking in a case where (e.g. HW flow control) is causing
         // a UART to overflow its buffers.  The behavior is to drop writes and log warnings.  
         // ESP32 HardwareSerial writebuffer appears to be 127 bytes by default so this should be enough
@@ -159,12 +319,18 @@ bool PluckyInterfaceSerial::writeAll(const uint8_t *buf, size_t size) {
         //  - BLE is not installed 
         //  - and CTSB is not grounded 
         //  - and BLE UART flow control is enabled.
+        if (prefixSize) {
+            _serial->write(prefix, prefixSize);
+        }
         _serial->write(buf, size);
+        _stats.framesOut++;
+        _stats.bytesOut += prefixSize + size;
         //Logger.debug.printf("Interface %s sent message %s\n", _interfaceName, buf);
 
         didWrite = true;
     } else {
-        Logger.warning.printf("WARNING: Interface %s send buffer full (size %d > available %d\n", _interfaceName, size, _serial->availableForWrite());
+        Logger.warning.printf("WARNING: Interface %s send buffer full (size %d > available %d\n", _interfaceName, prefixSize + size, _serial->availableForWrite());
+        _stats.writeDrops++;
     }
     return didWrite;
 }
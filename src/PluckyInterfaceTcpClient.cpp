@@ -1,9 +1,14 @@
+#include <errno.h>
+#include <lwip/sockets.h>
 #include<ArduinoSimpleLogging.h>
 
 #include "PluckyInterfaceTcpClient.hpp"
+#include "PluckyFrameCodec.hpp"
 #include "PluckyInterfaceSerial.hpp"
-#include "PluckyInterfaceGroup.hpp"
-#include "config.h"
+#include "PluckyRouter.hpp"
+#include "PluckyFilter.hpp"
+#include "PluckySettings.hpp"
+#include "config.hpp"
 
 void PluckyInterfaceTcpClient::doInit() {
   _readBufIndex = 0;
@@ -11,6 +16,12 @@ void PluckyInterfaceTcpClient::doInit() {
 }
 
 void PluckyInterfaceTcpClient::doLoop() {
+  if (_numRateLimits) {
+    _flushRateLimited();
+  }
+  if (_txFlushDue()) {
+    _flushTxQueue();
+  }
   readAll();
 }
 
@@ -20,10 +31,11 @@ void PluckyInterfaceTcpClient::begin() {
 }
 
 void PluckyInterfaceTcpClient::end() {
-  Logger.info.printf("Stopping interface %s\n", _interfaceName);
+  Logger.info.printf("Stopping interface %s (%u frames dropped, max queue depth %u)\n", _interfaceName, _txDrops, _txHighWater);
   _tcpClient.stop();
   _readBufIndex = 0;
-  sprintf(_interfaceName, "TCP [no client]");
+  _resetTxQueue();
+  _setInterfaceName("TCP [no client]");
 }
 
 bool PluckyInterfaceTcpClient::available() {
@@ -33,56 +45,439 @@ bool PluckyInterfaceTcpClient::available() {
 bool PluckyInterfaceTcpClient::readAll() {
   bool didRead = false;
   if (_tcpClient.available()) {
-    while (_tcpClient.available() && (_readBufIndex < READ_BUFFER_SIZE)) {
+    _lastActivity = millis();
+    while (_tcpClient.available() && (_readBufIndex < _readLimit())) {
       didRead = true;
       _readBuf[_readBufIndex] = _tcpClient.read();
       _readBufIndex++;
-      if (_readBuf[_readBufIndex - 1] == '\n') { 
+      _stats.bytesIn++;
+      if (_packed) {
+        if (_readBufIndex == 1 && _readBuf[0] > READ_BUFFER_SIZE - 1) {
+          // A frame this long could never complete, and nothing later in the stream
+          // can be trusted to start a frame, so give up on the client
+          _stats.overruns++;
+          Logger.warning.printf("WARNING: Interface %s sent a packed frame of %u bytes -- closing.\n", _interfaceName, _readBuf[0]);
+          end();
+          return false;
+        }
+        // Packed frames are complete once the length byte's worth has arrived
+        if (_readBufIndex == _readBuf[0] + 1) {
+          uint8_t frame[READ_BUFFER_SIZE];
+          uint16_t frameLen = unpackFrame(_readBuf, _readBufIndex, frame, READ_BUFFER_SIZE - 1);
+          _readBufIndex = 0;
+          if (frameLen == 0) {
+            Logger.warning.printf("WARNING: Interface %s sent a malformed packed frame -- dropping.\n", _interfaceName);
+          } else {
+            _handleFrame(frame, frameLen);
+          }
+        }
+      } else if (_readBuf[_readBufIndex - 1] == '\n') { 
         uint16_t sendLen = _readBufIndex;
         _readBufIndex = 0;
-
-        trimBuffer(_readBuf, sendLen, _interfaceName);
-        debugHandler(_readBuf, sendLen);
-
-        // Send to DE
-        extern PluckyInterfaceSerial de1Serial;
-        de1Serial.writeAll(_readBuf, sendLen);
-
-        // Broadcast to all interfaces if promiscuous usersetting is 1
-        // Note we assume that _readBuf is newline- and null-terminated, accomplished by trimBuffer
-        extern char *userSettingStr_promiscuous;
-        if (atoi(userSettingStr_promiscuous) == 1) {
-            char broadcastMessage[READ_BUFFER_SIZE+strlen(_interfaceName)+4];
-            sprintf(broadcastMessage, "{%s} %s", _interfaceName, (char *)_readBuf);
-            extern PluckyInterfaceGroup controllers;
-            controllers.writeAll((uint8_t *)broadcastMessage, strlen(broadcastMessage));
-        }
+        _handleFrame(_readBuf, sendLen);
       }
     }
   }
-  if (_readBufIndex >= READ_BUFFER_SIZE) {
+  // ASCII lines keep a byte spare for the filter's null terminator, which control
+  // lines are parsed by, so a line that fills the buffer without it is an overrun too
+  if (_readBufIndex >= _readLimit()) {
     didRead = false;
+    _stats.overruns++;
     Logger.warning.printf("WARNING: Read Buffer Overrun on interface %s -- purging.\n", _interfaceName);
     Logger.debug.print("    Buffer contents: ");
-    Logger.debug.write(_readBuf, READ_BUFFER_SIZE);
+    Logger.debug.write(_readBuf, _readBufIndex);
     Logger.debug.println();
     _readBufIndex = 0;
   } 
   return didRead;
 }
 
+void PluckyInterfaceTcpClient::_handleFrame(uint8_t *frame, uint16_t sendLen) {
+  _stats.framesIn++;
+  extern PluckyFlightRecorder flightRecorder;
+  flightRecorder.record(_traceId, (frame[0] == '!') ? TRACE_ID_NONE : TRACE_ID_DE1, frame, sendLen);
+  extern PluckyFilter frameFilter;
+  sendLen = frameFilter.run(ROUTE_TCP, frame, sendLen, _interfaceName, _stats);
+  if (sendLen == 0) {
+    return;
+  }
+  if (frame[0] == '!') {
+    // Control lines are for the bridge itself, never forwarded
+    _handleControlLine((char *)frame);
+    return;
+  }
+
+  // Send to DE (and wherever else the routing table says)
+  extern PluckyRouter router;
+  router.dispatch(ROUTE_TCP, _commandLane, (uint8_t *)_promiscuousPrefix, _promiscuousPrefixLen, frame, sendLen);
+}
+
+// line is null-terminated and still carries its '\n'
+void PluckyInterfaceTcpClient::_handleControlLine(const char *line) {
+  if (strcmp(line, "!packed\n") == 0 || strcmp(line, "!ascii\n") == 0) {
+    // Acknowledge in the old framing; everything the client receives after the 
+    // acknowledgement is in the new one
+    bool packed = (line[1] == 'p');
+    writeAll((const uint8_t *)line, strlen(line));
+    _setPacked(packed);
+    Logger.info.printf("Interface %s switched to %s framing\n", _interfaceName, packed ? "packed" : "ASCII");
+  } else if (strncmp(line, "!sub ", 5) == 0 || strncmp(line, "!unsub ", 7) == 0) {
+    bool subscribe = (line[1] == 's');
+    uint64_t tags = _parseTags(&line[subscribe ? 5 : 7]);
+    if (subscribe) {
+      _subscriptions |= tags;
+    } else {
+      _subscriptions &= ~tags;
+    }
+    writeAll((const uint8_t *)line, strlen(line));
+    Logger.info.printf("Interface %s subscriptions now %08x%08x\n", _interfaceName, 
+      (uint32_t)(_subscriptions >> 32), (uint32_t)_subscriptions);
+  } else if (strncmp(line, "!rate ", 6) == 0) {
+    // "!rate <tags> <per second>"; 0 lifts the limit
+    const char *hz = strrchr(line, ' ');
+    if (hz < &line[6]) {
+      Logger.warning.printf("WARNING: Interface %s sent %s without a rate", _interfaceName, line);
+      return;
+    }
+    char tags[READ_BUFFER_SIZE];
+    snprintf(tags, sizeof(tags), "%.*s", (int)(hz - &line[6]), &line[6]);
+    _setRateLimit(_parseTags(tags), atof(hz + 1));
+    writeAll((const uint8_t *)line, strlen(line));
+  } else if (strncmp(line, "!coalesce ", 10) == 0) {
+    _setCoalesce(&line[10]);
+    writeAll((const uint8_t *)line, strlen(line));
+  } else {
+    Logger.warning.printf("WARNING: Interface %s sent unknown control line %s", _interfaceName, line);
+  }
+}
+
+// "<ms> [bytes]", or "default" to follow the settings again.  Clamped to the settings' ranges.
+void PluckyInterfaceTcpClient::_setCoalesce(const char *args) {
+  if (strncmp(args, "default", 7) == 0) {
+    _coalesceMs = TCP_COALESCE_DEFAULT;
+    _coalesceBytes = TCP_COALESCE_DEFAULT;
+  } else {
+    char *end;
+    long ms = strtol(args, &end, 10);
+    if (end == args) {
+      Logger.warning.printf("WARNING: Interface %s sent !coalesce without a window: %s", _interfaceName, args);
+      return;
+    }
+    _coalesceMs = (ms < 0) ? 0 : (ms > 100) ? 100 : ms;
+    const char *bytesArg = end;
+    long bytes = strtol(bytesArg, &end, 10);
+    _coalesceBytes = (end == bytesArg) ? TCP_COALESCE_DEFAULT : (bytes < 64) ? 64 : (bytes > TCP_TX_QUEUE_SIZE) ? TCP_TX_QUEUE_SIZE : bytes;
+  }
+  Logger.info.printf("Interface %s coalesces for %u ms or %u bytes\n", _interfaceName, getCoalesceMs(), getCoalesceBytes());
+}
+
+uint16_t PluckyInterfaceTcpClient::getCoalesceMs() {
+  extern PluckySettings userSettings;
+  return (_coalesceMs == TCP_COALESCE_DEFAULT) ? userSettings.tcpCoalesceMs : _coalesceMs;
+}
+
+uint16_t PluckyInterfaceTcpClient::getCoalesceBytes() {
+  extern PluckySettings userSettings;
+  return (_coalesceBytes == TCP_COALESCE_DEFAULT) ? userSettings.tcpCoalesceBytes : _coalesceBytes;
+}
+
+void PluckyInterfaceTcpClient::_setRateLimit(uint64_t tags, float hz) {
+  for (int tag = 0; tag < DE1_NUM_TAGS; tag++) {
+    uint64_t tagBit = 1ULL << tag;
+    if (!(tags & tagBit)) {
+      continue;
+    }
+    int slot = 0;
+    while (slot < _numRateLimits && _rateLimits[slot].tagBit != tagBit) {
+      slot++;
+    }
+    if (hz <= 0) {
+      if (slot < _numRateLimits) {
+        // Whatever was held goes out now rather than being lost
+        RateLimit &limit = _rateLimits[slot];
+        if (limit.pendingLen) {
+          writeAll(limit.pending, limit.pendingLen);
+        }
+        _rateLimits[slot] = _rateLimits[--_numRateLimits];
+        _rateLimitedTags &= ~tagBit;
+      }
+      continue;
+    }
+    if (slot == _numRateLimits) {
+      if (_numRateLimits == TCP_RATE_MAX_TAGS) {
+        Logger.warning.printf("WARNING: Interface %s asked to rate limit more than %d tags; [%c] is not limited\n", 
+          _interfaceName, TCP_RATE_MAX_TAGS, '@' + tag);
+        continue;
+      }
+      _numRateLimits++;
+      _rateLimits[slot].tagBit = tagBit;
+      _rateLimits[slot].lastSentAt = millis() - 60000;
+      _rateLimits[slot].pendingLen = 0;
+      _rateLimitedTags |= tagBit;
+    }
+    _rateLimits[slot].intervalMs = (hz >= 1000) ? 1 : (hz <= 1.0f / 60) ? 60000 : (unsigned long)(1000 / hz);
+    Logger.info.printf("Interface %s limits [%c] to one frame per %lu ms\n", _interfaceName, '@' + tag, _rateLimits[slot].intervalMs);
+  }
+}
+
+bool PluckyInterfaceTcpClient::_holdForRateLimit(uint64_t tagBit, const uint8_t *buf, size_t size) {
+  if (size > TCP_RATE_FRAME_SIZE) {
+    return false;
+  }
+  for (int i = 0; i < _numRateLimits; i++) {
+    RateLimit &limit = _rateLimits[i];
+    if (limit.tagBit != tagBit) {
+      continue;
+    }
+    unsigned long now = millis();
+    if (limit.pendingLen == 0 && now - limit.lastSentAt >= limit.intervalMs) {
+      limit.lastSentAt = now;
+      return false;
+    }
+    // Latest wins: replace whatever is waiting for the end of the interval
+    if (limit.pendingLen) {
+      _rateSkips++;
+    }
+    memcpy(limit.pending, buf, size);
+    limit.pendingLen = size;
+    return true;
+  }
+  return false;
+}
+
+// Sends the frames held by rate limits whose interval has ended
+void PluckyInterfaceTcpClient::_flushRateLimited() {
+  unsigned long now = millis();
+  for (int i = 0; i < _numRateLimits; i++) {
+    RateLimit &limit = _rateLimits[i];
+    if (limit.pendingLen && now - limit.lastSentAt >= limit.intervalMs) {
+      limit.lastSentAt = now;
+      writeAll(limit.pending, limit.pendingLen);
+      limit.pendingLen = 0;
+    }
+  }
+}
+
+// Tags may be given bare or bracketed and separated by spaces or commas: "M N", "[M],[N]", "MN".
+// "*" means every tag.
+uint64_t PluckyInterfaceTcpClient::_parseTags(const char *tags) {
+  uint64_t bits = 0;
+  for (const char *c = tags; *c && *c != '\n'; c++) {
+    if (*c == '*') {
+      bits = TCP_SUBSCRIBE_ALL;
+    } else if ((uint8_t)*c >= '@' && (uint8_t)*c <= 0x7F && *c != '[' && *c != ']') {
+      bits |= 1ULL << ((uint8_t)*c - '@');
+    }
+  }
+  return bits;
+}
+
+void PluckyInterfaceTcpClient::_setPacked(bool packed) {
+  _packed = packed;
+  // Whatever is still queued was framed the old way; treat it as one opaque frame
+  _txFrameLeft = _txQueue.used();
+  _txMidFrame = false;
+}
+
 
 bool PluckyInterfaceTcpClient::availableForWrite(size_t len) {
-  return _tcpClient.connected();
+  return _tcpClient.connected() && (_txQueue.available() > len);
 }
 
 bool PluckyInterfaceTcpClient::writeAll(const uint8_t *buf, size_t size) {
-  return _tcpClient.write(buf, size);
+  return writeAllPrefixed(NULL, 0, buf, size);
+}
+
+bool PluckyInterfaceTcpClient::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+  if (_packed) {
+    if (!_tcpClient.connected() || size == 0) {
+      return false;
+    }
+    uint8_t packedFrame[PACKED_FRAME_MAX_SIZE];
+    size_t packedSize = packFrame(prefix, prefixSize, buf, size, packedFrame);
+    if (packedSize == 0) {
+      return false;
+    }
+    return _queueFrame(NULL, 0, packedFrame, packedSize);
+  }
+  return _queueFrame(prefix, prefixSize, buf, size);
+}
+
+bool PluckyInterfaceTcpClient::writePacked(const uint8_t *packedFrame, size_t packedSize) {
+  if (!_packed) {
+    return false;
+  }
+  return _queueFrame(NULL, 0, packedFrame, packedSize);
+}
+
+bool PluckyInterfaceTcpClient::_queueFrame(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+  if (!_tcpClient.connected() || size == 0) {
+    return false;
+  }
+  if (_txQueue.available() < prefixSize + size && !_makeTxRoom(prefixSize + size)) {
+    return false;
+  }
+  if (_txQueue.empty()) {
+    _txQueuedAt = millis();
+  }
+  // Both pieces go in back to back, so the queue only ever holds whole frames
+  _txQueue.push(prefix, prefixSize);
+  _txQueue.push(buf, size);
+  _txFrames++;
+  _stats.framesOut++;
+  _stats.bytesOut += prefixSize + size;
+  if (_txQueue.used() > _txHighWater) {
+    _txHighWater = _txQueue.used();
+  }
+  // Usually the socket has room and this sends the frame right away.  When coalescing,
+  // doLoop() sends it along with whatever else arrives within the window.
+  if (_txFlushDue()) {
+    _flushTxQueue();
+  }
+  return true;
+}
+
+void PluckyInterfaceTcpClient::_resetTxQueue() {
+  _txQueue.clear();
+  _txMidFrame = false;
+  _txFrameLeft = 0;
+  _txQueuedAt = 0;
+  _txFrames = 0;
+  _txWrites = 0;
+  _txDropping = false;
+  _txHighWater = 0;
+  _txDrops = 0;
+}
+
+// Applies the overflow policy.  Returns true if there is now room for `size` bytes.
+bool PluckyInterfaceTcpClient::_makeTxRoom(size_t size) {
+  extern PluckySettings userSettings;
+  int policy = userSettings.tcpOverflowPolicy;
+
+  if (!_txDropping) {
+    Logger.warning.printf("WARNING: Interface %s is not keeping up (queue %u bytes) -- applying overflow policy %d\n", _interfaceName, _txQueue.used(), policy);
+    _txDropping = true;
+  }
+
+  if (policy == TCP_OVERFLOW_DISCONNECT) {
+    end();
+    return false;
+  }
+
+  if (policy == TCP_OVERFLOW_DROP_OLDEST && size <= TCP_TX_QUEUE_SIZE) {
+    // Drop whole frames from the head until the new one fits.  A frame that is 
+    // already partially on the wire can't be pulled back without garbling the 
+    // stream, so in that case fall through and drop the new frame instead.
+    while (!_txMidFrame && _txFrameLeft == 0 && _txQueue.available() < size) {
+      _txQueue.consume(_txHeadFrameSize());
+      _txDrops++;
+      _stats.writeDrops++;
+    }
+    if (_txQueue.available() >= size) {
+      return true;
+    }
+  }
+
+  _txDrops++;
+  _stats.writeDrops++;
+  return false;
+}
+
+// Sends as much of the queue as the socket will take right now, without blocking.
+void PluckyInterfaceTcpClient::_flushTxQueue() {
+  while (!_txQueue.empty()) {
+    const uint8_t *data;
+    size_t span = _txQueue.readSpan(&data);
+    int sent = lwip_send(_tcpClient.fd(), data, span, MSG_DONTWAIT);
+    if (sent > 0) {
+      _txWrites++;
+      _lastActivity = millis();
+      _txSent(data, sent);
+      _txQueue.consume(sent);
+    } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      Logger.info.printf("Interface %s send failed (errno %d)\n", _interfaceName, errno);
+      end();
+      return;
+    } else {
+      return; // socket buffer full; try again on the next doLoop()
+    }
+  }
+  _txDropping = false;
+}
+
+// True when the queue should go out now rather than wait for more frames to coalesce with
+bool PluckyInterfaceTcpClient::_txFlushDue() {
+  uint16_t windowMs = getCoalesceMs();
+  if (windowMs == 0) {
+    return true;
+  }
+  return (_txQueue.used() >= getCoalesceBytes()) || 
+         (millis() - _txQueuedAt >= windowMs);
+}
+
+// Size of the whole frame at the head of the queue (which must be at a frame boundary)
+size_t PluckyInterfaceTcpClient::_txHeadFrameSize() {
+  if (_packed) {
+    uint8_t len;
+    _txQueue.peek(&len, 1);
+    return 1 + len;
+  }
+  int lfIndex = _txQueue.find('\n', _txQueue.used());
+  return (lfIndex >= 0) ? (lfIndex + 1) : _txQueue.used();
+}
+
+// Tracks where the frame boundaries fall after `sent` bytes from data went out
+void PluckyInterfaceTcpClient::_txSent(const uint8_t *data, size_t sent) {
+  if (sent <= _txFrameLeft) {
+    _txFrameLeft -= sent;
+    return;
+  }
+  if (_packed) {
+    size_t next = _txFrameLeft;
+    while (next < sent) {
+      next += 1 + data[next];
+    }
+    _txFrameLeft = next - sent;
+  } else {
+    _txFrameLeft = 0;
+    _txMidFrame = (data[sent - 1] != '\n');
+  }
 }
 
 void PluckyInterfaceTcpClient::setTcpClient(WiFiClient newClient) {
   _tcpClient = newClient;
   _readBufIndex = 0;
-  sprintf (_interfaceName, "TCP[%s : %d]", _tcpClient.remoteIP().toString().c_str(), (int)_tcpClient.remotePort());  
+  _packed = false;
+  _subscriptions = TCP_SUBSCRIBE_ALL;
+  _numRateLimits = 0;
+  _rateLimitedTags = 0;
+  _rateSkips = 0;
+  _coalesceMs = TCP_COALESCE_DEFAULT;
+  _coalesceBytes = TCP_COALESCE_DEFAULT;
+  _lastActivity = millis();
+  _resetTxQueue();
+  _enableKeepalive();
+  char name[sizeof(_interfaceName)];
+  snprintf(name, sizeof(name), "TCP[%s : %d]", _tcpClient.remoteIP().toString().c_str(), (int)_tcpClient.remotePort());
+  _setInterfaceName(name);
   begin();
-}
\ No newline at end of file
+}
+
+void PluckyInterfaceTcpClient::_enableKeepalive() {
+  int fd = _tcpClient.fd();
+  int enable = 1;
+  int idle = TCP_KEEPALIVE_IDLE_S;
+  int interval = TCP_KEEPALIVE_INTERVAL_S;
+  int count = TCP_KEEPALIVE_COUNT;
+  if (lwip_setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable)) < 0 ||
+      lwip_setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle)) < 0 ||
+      lwip_setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval)) < 0 ||
+      lwip_setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) < 0) {
+    Logger.warning.printf("WARNING: Could not enable TCP keepalive on fd %d (errno %d)\n", fd, errno);
+  }
+}
+
+void PluckyInterfaceTcpClient::_setInterfaceName(const char *name) {
+  snprintf(_interfaceName, sizeof(_interfaceName), "%s", name);
+  _promiscuousPrefixLen = sprintf(_promiscuousPrefix, "{%s} ", _interfaceName);
+}
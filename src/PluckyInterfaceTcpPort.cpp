@@ -1,25 +1,35 @@
 #include <WiFiServer.h>
-#include <WifiClient.h>
-#include <Wifi.h>
+#include <WiFiClient.h>
+#include <WiFi.h>
 #include <ArduinoSimpleLogging.h>
+#include <new>
 
 #include "PluckyInterfaceTcpPort.hpp"
 #include "PluckyInterfaceTcpClient.hpp"
+#include "PluckyFrameCodec.hpp"
+#include "PluckyDe1State.hpp"
+#include "PluckySettings.hpp"
 #include "config.hpp"
 
 PluckyInterfaceTcpPort::PluckyInterfaceTcpPort(uint16_t port) : PluckyInterfaceGroup(TCP_MAX_CLIENTS) {
     _tcpPort = port;
     _tcpServer = WiFiServer(port, TCP_MAX_CLIENTS);
+    _lastStatsReport = 0;
+    _lastReportedDrops = 0;
+    _lastIdleCheck = 0;
+    // Slots are filled in by _acceptClient() as clients arrive
     for (uint16_t i=0; i<TCP_MAX_CLIENTS; i++) {
-        _interfaces[i] = new PluckyInterfaceTcpClient();
+        _interfaces[i] = NULL;
     }
+    extern PluckySettings userSettings;
+    userSettings.subscribe(SETTING_TCP_PORT, _settingsChanged_CB, this);
 }
 
 PluckyInterfaceTcpPort::~PluckyInterfaceTcpPort() {
+    extern PluckySettings userSettings;
+    userSettings.unsubscribe(this);
     for (uint16_t i=0; i<TCP_MAX_CLIENTS; i++) {
-// This should technically get deleted but since this is in effect a singletion class,
-// commenting it out as it makes the compliler mildly grumpy (polymorphic destructor)
-//        delete (PluckyInterfaceTcpClient *)(_interfaces[i]);
+        delete _client(i);
     }
 }
 
@@ -35,29 +45,193 @@ void PluckyInterfaceTcpPort::doLoop() {
     }
 
     // Check for new incoming connections
-    if (_tcpServer && _tcpServer.hasClient()) { // find free/disconnected spot
-        Logger.info.print("New TCP client ");
-        for (uint16_t i = 0; i < _numInterfaces; i ++) {
-            if (!((PluckyInterfaceTcpClient *)_interfaces[i])->connected()) {
-                Logger.info.printf("in slot: %d\n", i);
-                ((PluckyInterfaceTcpClient *)_interfaces[i])->setTcpClient(_tcpServer.available());
-                break;
-            } else {
-                Logger.info.print(". ");
-            }
-            if (i == _numInterfaces - 1) { // no free/disconnected spot so reject it
-                WiFiClient TmpserverClient = _tcpServer.available();
-                TmpserverClient.stop();
-                Logger.info.println("Too many TCP clients; new connection dropped");
-            }   
+    if (_tcpServer && _tcpServer.hasClient()) {
+        _acceptClient();
+    }
+
+    if (millis() - _lastIdleCheck >= TCP_IDLE_CHECK_MS) {
+        _lastIdleCheck = millis();
+        _closeIdleClients();
+    }
+
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            _loopChild(i);
+        }
+    }
+
+    if (millis() - _lastStatsReport >= TCP_STATS_INTERVAL_MS) {
+        _lastStatsReport = millis();
+        _reportStats();
+    }
+}
+
+void PluckyInterfaceTcpPort::_acceptClient() {
+    // First free slot under the limit, allocating it if it has never been used
+    uint16_t limit = getPoolLimit();
+    uint16_t slot = 0;
+    while (slot < limit && _interfaces[slot] && _client(slot)->connected()) {
+        slot++;
+    }
+    if (slot == limit) {
+        slot = _pickEviction(limit);
+        PluckyInterfaceTcpClient *victim = _client(slot);
+        Logger.info.printf("TCP pool full (%d clients); evicting %s from slot %d (%u bytes queued, idle %lu ms)\n",
+            limit, victim->getName(), slot, victim->getTxQueueDepth(), victim->getIdleMillis());
+        victim->end();
+        _stats.evictions++;
+    }
+    if (!_interfaces[slot]) {
+        PluckyInterfaceTcpClient *client = new (std::nothrow) PluckyInterfaceTcpClient();
+        if (!client) {
+            WiFiClient rejected = _tcpServer.available();
+            rejected.stop();
+            _stats.rejects++;
+            Logger.warning.printf("WARNING: No memory for TCP slot %d; new connection dropped\n", slot);
+            return;
         }
-    }     
+        client->setTraceId(TRACE_ID_TCP_BASE + slot);
+        client->setCommandLane(DE1_QUEUE_LANE_TCP_BASE + slot % DE1_QUEUE_TCP_LANES);
+        _interfaces[slot] = client;
+    }
+
+    Logger.info.printf("New TCP client in slot: %d\n", slot);
+    _client(slot)->setTcpClient(_tcpServer.available());
+    _stats.connects++;
+    // Bring the client up to date without waiting for the DE1 to repeat itself
+    extern PluckyDe1State de1State;
+    uint16_t numFrames = de1State.writeSnapshot(_interfaces[slot]);
+    Logger.info.printf("Sent %d cached DE1 frames to TCP slot %d\n", numFrames, slot);
+}
 
+// Slot of the client to disconnect when all limit slots are taken: the most backlogged
+// one if any is at least TCP_EVICT_BACKLOG_BYTES behind, otherwise the one idle longest
+uint16_t PluckyInterfaceTcpPort::_pickEviction(uint16_t limit) {
+    uint16_t backlogged = limit;
+    uint16_t deepest = 0;
+    uint16_t idlest = 0;
+    unsigned long longestIdle = 0;
+    for (uint16_t i=0; i<limit; i++) {
+        PluckyInterfaceTcpClient *client = _client(i);
+        uint16_t depth = client->getTxQueueDepth();
+        if (depth >= TCP_EVICT_BACKLOG_BYTES && depth > deepest) {
+            deepest = depth;
+            backlogged = i;
+        }
+        unsigned long idle = client->getIdleMillis();
+        if (idle >= longestIdle) {
+            longestIdle = idle;
+            idlest = i;
+        }
+    }
+    return (backlogged < limit) ? backlogged : idlest;
+}
+
+void PluckyInterfaceTcpPort::_closeIdleClients() {
+    extern PluckySettings userSettings;
+    unsigned long timeoutMs = userSettings.tcpIdleTimeoutMs;
+    uint16_t limit = getPoolLimit();
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        _interfaces[i]->doLoop();
+        PluckyInterfaceTcpClient *client = _client(i);
+        if (!client || !client->connected()) {
+            continue;
+        }
+        if (i >= limit) {
+            // The limit was lowered since this client connected
+            Logger.info.printf("TCP slot %d is beyond the limit of %d clients; closing %s\n", i, limit, client->getName());
+            client->end();
+            _stats.evictions++;
+        } else if (timeoutMs > 0 && client->getIdleMillis() >= timeoutMs) {
+            Logger.info.printf("TCP client %s in slot %d idle for %lu s; closing\n", client->getName(), i, client->getIdleMillis() / 1000);
+            client->end();
+            _stats.timeouts++;
+        }
     }
 }
 
+void PluckyInterfaceTcpPort::setPort(uint16_t port) {
+    if (port == _tcpPort) {
+        return;
+    }
+    Logger.info.printf("TCP port changing from %u to %u; %u connected clients stay connected\n", _tcpPort, port, getClientCount());
+    if (_tcpServer) {
+        end();
+    }
+    _tcpPort = port;
+    _tcpServer = WiFiServer(port, TCP_MAX_CLIENTS);
+}
+
+void PluckyInterfaceTcpPort::_settingsChanged_CB(uint32_t changed, void *ctx) {
+    extern PluckySettings userSettings;
+    ((PluckyInterfaceTcpPort *)ctx)->setPort(userSettings.tcpPort);
+}
+
+uint16_t PluckyInterfaceTcpPort::getPoolLimit() {
+    extern PluckySettings userSettings;
+    return userSettings.tcpMaxClients;
+}
+
+uint16_t PluckyInterfaceTcpPort::getClientCount() {
+    uint16_t count = 0;
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i] && _client(i)->connected()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint16_t PluckyInterfaceTcpPort::getAllocatedCount() {
+    uint16_t count = 0;
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void PluckyInterfaceTcpPort::_reportStats() {
+    // Only speak up if some client has dropped frames since the last report,
+    // or if any client is coalescing (to show how well it is batching)
+    uint32_t totalDrops = 0;
+    bool coalescing = false;
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            totalDrops += _client(i)->getTxDrops();
+            coalescing |= _client(i)->connected() && _client(i)->getCoalesceMs() > 0;
+        }
+    }
+    if (totalDrops == _lastReportedDrops && !coalescing) {
+        return;
+    }
+    _lastReportedDrops = totalDrops;
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        PluckyInterfaceTcpClient *client = _client(i);
+        if (client && client->connected()) {
+            Logger.info.printf("TCP slot %d %s: queue %u/%u bytes (max %u), %u frames dropped, %u frames sent in %u writes, %u skipped by rate limits\n", i, client->getName(),
+                client->getTxQueueDepth(), TCP_TX_QUEUE_SIZE, client->getTxQueueHighWater(), client->getTxDrops(),
+                client->getTxFrames(), client->getTxWrites(), client->getRateSkips());
+        }
+    }
+}
+
+void PluckyInterfaceTcpPort::visitStats(PluckyStatsVisitor fn, void *ctx) {
+    fn(getName(), _stats, ctx);
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (!_interfaces[i]) {
+            continue;
+        }
+        char slotName[16];
+        _childName(i, slotName, sizeof(slotName));
+        fn(slotName, _interfaces[i]->getStats(), ctx);
+    }
+}
+
+void PluckyInterfaceTcpPort::_childName(uint16_t i, char *buf, size_t size) {
+    snprintf(buf, size, "TCP_%d", i);
+}
+
 void PluckyInterfaceTcpPort::begin() {
     _tcpServer.begin(); // start TCP server
     _tcpServer.setNoDelay(true);
@@ -73,7 +247,7 @@ bool PluckyInterfaceTcpPort::available() {
     // Note, because readAll() visits and reads ALL interfaces in the group
     // this does not introduce a bias / risk of starvation.
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        if (_interfaces[i]->available()) {
+        if (_interfaces[i] && _interfaces[i]->available()) {
             return true;
         }
     }
@@ -83,7 +257,7 @@ bool PluckyInterfaceTcpPort::available() {
 bool PluckyInterfaceTcpPort::readAll() {
     bool didRead = false;
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        if (_interfaces[i]->available()) {
+        if (_interfaces[i] && _interfaces[i]->available()) {
             didRead = (_interfaces[i]->readAll() || didRead);
         }
     }
@@ -96,7 +270,7 @@ bool PluckyInterfaceTcpPort::availableForWrite(size_t len) {
     // (leaving it to the leaf interfaces to handle buffering, flushing, closing, etc)
     // this does not introduce a risk of blockage or starvation.
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        if (_interfaces[i]->availableForWrite(len)) {
+        if (_interfaces[i] && _interfaces[i]->availableForWrite(len)) {
             return true;
         }
     }
@@ -105,9 +279,33 @@ bool PluckyInterfaceTcpPort::availableForWrite(size_t len) {
 
 bool PluckyInterfaceTcpPort::writeAll(const uint8_t *buf, size_t size) {
     bool didWrite = false;
+    // Packed clients all get the same bytes, so pack at most once per frame
+    uint8_t packedFrame[PACKED_FRAME_MAX_SIZE];
+    size_t packedSize = 0;
+    uint64_t tagBit = frameTagBit(buf, size);
     for (uint16_t i=0; i<_numInterfaces; i++) {
-        didWrite = (_interfaces[i]->writeAll(buf, size) || didWrite);
+        PluckyInterfaceTcpClient *client = _client(i);
+        if (!client || !client->isSubscribed(tagBit) || client->rateLimited(tagBit, buf, size)) {
+            continue;
+        }
+        if (client->isPacked()) {
+            if (packedSize == 0) {
+                packedSize = packFrame(NULL, 0, buf, size, packedFrame);
+            }
+            didWrite = (client->writePacked(packedFrame, packedSize) || didWrite);
+        } else {
+            didWrite = (client->writeAll(buf, size) || didWrite);
+        }
     }
     return didWrite;
 }
 
+bool PluckyInterfaceTcpPort::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+    bool didWrite = false;
+    for (uint16_t i=0; i<_numInterfaces; i++) {
+        if (_interfaces[i]) {
+            didWrite = (_interfaces[i]->writeAllPrefixed(prefix, prefixSize, buf, size) || didWrite);
+        }
+    }
+    return didWrite;
+}
@@ -0,0 +1,119 @@
+#include <ArduinoSimpleLogging.h>
+
+#include "PluckyInterfaceUdpPublisher.hpp"
+#include "PluckySettings.hpp"
+
+static const char hexDigits[] = "0123456789abcdef";
+
+PluckyInterfaceUdpPublisher::PluckyInterfaceUdpPublisher() {
+  _port = 0;
+  _enabled = false;
+  _wifiConnected = false;
+  _sequence = 0;
+  _lastConfigCheck = 0;
+  _settingsChanged = true;
+  extern PluckySettings userSettings;
+  userSettings.subscribe(SETTING_UDP_ADDRESS | SETTING_UDP_PORT, _settingsChanged_CB, this);
+}
+
+PluckyInterfaceUdpPublisher::~PluckyInterfaceUdpPublisher() {
+  extern PluckySettings userSettings;
+  userSettings.unsubscribe(this);
+}
+
+void PluckyInterfaceUdpPublisher::_settingsChanged_CB(uint32_t changed, void *ctx) {
+  PluckyInterfaceUdpPublisher *publisher = (PluckyInterfaceUdpPublisher *)ctx;
+  publisher->_settingsChanged = true;
+  publisher->_configure();
+}
+
+void PluckyInterfaceUdpPublisher::doInit() {
+  begin();
+}
+
+void PluckyInterfaceUdpPublisher::doLoop() {
+  if (millis() - _lastConfigCheck >= UDP_CONFIG_CHECK_MS) {
+    _lastConfigCheck = millis();
+    _configure();
+  }
+}
+
+void PluckyInterfaceUdpPublisher::begin() {
+  _lastConfigCheck = millis();
+  _configure();
+}
+
+void PluckyInterfaceUdpPublisher::end() {
+  if (_enabled) {
+    Logger.info.println("Stopping UDP publisher");
+  }
+  _enabled = false;
+  _udp.stop();
+}
+
+// Applies the UDP settings if they (or the WiFi connection) changed since last time
+void PluckyInterfaceUdpPublisher::_configure() {
+  extern PluckySettings userSettings;
+  bool wifiConnected = (WiFi.status() == WL_CONNECTED);
+  if (wifiConnected == _wifiConnected && !_settingsChanged) {
+    return;
+  }
+  _wifiConnected = wifiConnected;
+  _settingsChanged = false;
+  end();
+
+  const char *address = userSettings.udpAddress;
+  if (!wifiConnected || address[0] == 0) {
+    return;
+  }
+  const char *kind = "unicast";
+  if (strcasecmp(address, "broadcast") == 0) {
+    // The subnet's broadcast address, which moves with the DHCP lease
+    _address = IPAddress((uint32_t)WiFi.localIP() | ~(uint32_t)WiFi.subnetMask());
+    kind = "broadcast";
+  } else if (!_address.fromString(address)) {
+    Logger.warning.printf("WARNING: UDP address %s is not an IP address; UDP publisher off\n", address);
+    return;
+  } else if (_address[0] >= 224 && _address[0] <= 239) {
+    kind = "multicast";
+  }
+  _port = userSettings.udpPort;
+  _enabled = true;
+  Logger.info.printf("UDP publisher sending to %s:%u (%s), next sequence %u\n", 
+    _address.toString().c_str(), _port, kind, _sequence);
+}
+
+bool PluckyInterfaceUdpPublisher::writeAll(const uint8_t *buf, size_t size) {
+  return writeAllPrefixed(NULL, 0, buf, size);
+}
+
+bool PluckyInterfaceUdpPublisher::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+  if (!_enabled || size == 0) {
+    return false;
+  }
+  // Numbered even if the send fails, so the receiver sees the loss
+  uint32_t sequence = _sequence++;
+  uint8_t header[UDP_SEQUENCE_SIZE];
+  for (int i = 7; i >= 0; i--) {
+    header[i] = hexDigits[sequence & 0xF];
+    sequence >>= 4;
+  }
+  header[8] = ' ';
+
+  if (!_udp.beginPacket(_address, _port)) {
+    _stats.writeDrops++;
+    return false;
+  }
+  _udp.write(header, sizeof(header));
+  if (prefixSize) {
+    _udp.write(prefix, prefixSize);
+  }
+  _udp.write(buf, size);
+  if (!_udp.endPacket()) {
+    _stats.writeDrops++;
+    return false;
+  }
+  _stats.framesOut++;
+  _stats.bytesOut += sizeof(header) + prefixSize + size;
+  return true;
+}
@@ -0,0 +1,196 @@
+#include <lwip/sockets.h>
+#include <ArduinoSimpleLogging.h>
+
+#include "PluckyInterfaceWebSocket.hpp"
+#include "PluckyInterfaceSerial.hpp"
+#include "PluckyRouter.hpp"
+#include "PluckyFilter.hpp"
+#include "PluckyCommandQueue.hpp"
+#include "PluckyDe1State.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "config.hpp"
+
+PluckyInterfaceWebSocket::PluckyInterfaceWebSocket(uint16_t port) {
+  _port = port;
+  _ws = new PluckyWebSocketsServer(port);
+  for (int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    _promiscuousPrefix[i][0] = 0;
+    _promiscuousPrefixLen[i] = 0;
+    _stalledSince[i] = 0;
+  }
+}
+
+PluckyInterfaceWebSocket::~PluckyInterfaceWebSocket() {
+  delete _ws;
+}
+
+void PluckyInterfaceWebSocket::doInit() {
+  begin();
+}
+
+void PluckyInterfaceWebSocket::doLoop() {
+  // Accepts connections and delivers received messages through _handleEvent()
+  _ws->loop();
+}
+
+void PluckyInterfaceWebSocket::begin() {
+  _ws->onEvent([this](uint8_t num, WStype_t type, uint8_t *payload, size_t length) {
+    _handleEvent(num, type, payload, length);
+  });
+  _ws->begin();
+  Logger.info.printf("WebSocket server enabled on port %d\n", _port);
+}
+
+void PluckyInterfaceWebSocket::end() {
+  Logger.info.println("Stopping WebSocket server");
+  _ws->close();
+}
+
+bool PluckyInterfaceWebSocket::available() {
+  // Incoming messages are pushed to us from doLoop(); there is nothing to poll
+  return false;
+}
+
+bool PluckyInterfaceWebSocket::readAll() {
+  return false;
+}
+
+bool PluckyInterfaceWebSocket::availableForWrite(size_t len) {
+  return _ws->connectedClients() > 0;
+}
+
+bool PluckyInterfaceWebSocket::writeAll(const uint8_t *buf, size_t size) {
+  if (size > 0 && buf[size - 1] == '\n') {
+    size--;
+  }
+  if (size == 0) {
+    return false;
+  }
+  // Client by client rather than broadcastTXT(), so one that can't keep up is skipped
+  // instead of stalling the write for everyone
+  bool sent = false;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    int fd = _ws->clientFd(num);
+    if (fd < 0) {
+      continue;
+    }
+    if (!_clientHasRoom(num, fd)) {
+      _stats.writeDrops++;
+      continue;
+    }
+    if (!_ws->sendTXT(num, buf, size)) {
+      _stats.writeDrops++;
+      continue;
+    }
+    sent = true;
+  }
+  if (!sent) {
+    return false;
+  }
+  _stats.framesOut++;
+  _stats.bytesOut += size;
+  return true;
+}
+
+// Whether client num's socket can take a message without blocking.  Tracks how long it
+// has been unable to, and disconnects it after WEBSOCKET_STALL_TIMEOUT_MS.
+bool PluckyInterfaceWebSocket::_clientHasRoom(uint8_t num, int fd) {
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(fd, &writeSet);
+  struct timeval noWait = { 0, 0 };
+  if (lwip_select(fd + 1, NULL, &writeSet, NULL, &noWait) > 0) {
+    if (_stalledSince[num]) {
+      Logger.info.printf("WebSocket client %d is keeping up again\n", num);
+      _stalledSince[num] = 0;
+    }
+    return true;
+  }
+  unsigned long now = millis();
+  if (!_stalledSince[num]) {
+    Logger.warning.printf("WARNING: WebSocket client %d is not keeping up -- skipping frames\n", num);
+    _stalledSince[num] = now | 1;
+  } else if (now - _stalledSince[num] >= WEBSOCKET_STALL_TIMEOUT_MS) {
+    Logger.warning.printf("WARNING: Disconnecting WebSocket client %d, stalled for %lu ms\n", num, now - _stalledSince[num]);
+    _stalledSince[num] = 0;
+    _ws->disconnect(num);
+  }
+  return false;
+}
+
+bool PluckyInterfaceWebSocket::writeAllPrefixed(const uint8_t *prefix, size_t prefixSize, const uint8_t *buf, size_t size) {
+  if (_ws->connectedClients() == 0) {
+    return false;
+  }
+  // One message per frame, so the pieces have to be joined here
+  uint8_t message[PROMISCUOUS_PREFIX_SIZE + READ_BUFFER_SIZE];
+  if (prefixSize + size > sizeof(message)) {
+    return false;
+  }
+  memcpy(message, prefix, prefixSize);
+  memcpy(message + prefixSize, buf, size);
+  return writeAll(message, prefixSize + size);
+}
+
+void PluckyInterfaceWebSocket::_handleEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length) {
+  switch (type) {
+    case WStype_CONNECTED: {
+      IPAddress ip = _ws->remoteIP(num);
+      _promiscuousPrefixLen[num] = snprintf(_promiscuousPrefix[num], PROMISCUOUS_PREFIX_SIZE, "{WS[%s]} ", ip.toString().c_str());
+      Logger.info.printf("New WebSocket client %d from %s\n", num, ip.toString().c_str());
+      _stats.connects++;
+      _stalledSince[num] = 0;
+      _sendSnapshot(num);
+      break;
+    }
+    case WStype_DISCONNECTED:
+      Logger.info.printf("WebSocket client %d disconnected\n", num);
+      break;
+    case WStype_TEXT:
+      _handleFrame(num, payload, length);
+      break;
+    default:
+      break;
+  }
+}
+
+void PluckyInterfaceWebSocket::_handleFrame(uint8_t num, uint8_t *payload, size_t length) {
+  _stats.framesIn++;
+  _stats.bytesIn += length;
+  extern PluckyFlightRecorder flightRecorder;
+  flightRecorder.record(TRACE_ID_WEBSOCKET, TRACE_ID_DE1, payload, length);
+  // Messages arrive without a newline; restore it so the DE1 sees an ordinary frame
+  if (length > 0 && payload[length - 1] == '\n') {
+    length--;
+  }
+  if (length == 0 || length + 1 >= READ_BUFFER_SIZE) {
+    Logger.warning.printf("WARNING: Dropped %d byte message from WebSocket client %d\n", length, num);
+    _stats.overruns++;
+    return;
+  }
+  memcpy(_readBuf, payload, length);
+  _readBuf[length] = '\n';
+  uint16_t sendLen = length + 1;
+
+  extern PluckyFilter frameFilter;
+  sendLen = frameFilter.run(ROUTE_WEBSOCKET, _readBuf, sendLen, _promiscuousPrefix[num], _stats);
+  if (sendLen == 0) {
+    return;
+  }
+
+  // Send to DE (and wherever else the routing table says)
+  extern PluckyRouter router;
+  router.dispatch(ROUTE_WEBSOCKET, DE1_QUEUE_LANE_WEBSOCKET, (uint8_t *)_promiscuousPrefix[num], _promiscuousPrefixLen[num], _readBuf, sendLen);
+}
+
+void PluckyInterfaceWebSocket::_sendSnapshot(uint8_t num) {
+  // Bring the new client up to date without waiting for the DE1 to repeat itself
+  extern PluckyDe1State de1State;
+  uint8_t frame[DE1_STATE_FRAME_SIZE];
+  for (int tag = 0; tag < DE1_NUM_TAGS; tag++) {
+    size_t len = de1State.get(tag, frame);
+    if (len > 1) {
+      _ws->sendTXT(num, frame, len - 1);
+    }
+  }
+}
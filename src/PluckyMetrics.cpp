@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <esp_system.h>
+
+#include "PluckyMetrics.hpp"
+#include "PluckyInterfaceSerial.hpp"
+#include "PluckyInterfaceGroup.hpp"
+#include "PluckyInterfaceTcpPort.hpp"
+#include "PluckyShotRecorder.hpp"
+
+struct MetricsSnapshot {
+  uint8_t count;
+  char names[METRICS_MAX_INTERFACES][32];
+  PluckyInterfaceStats stats[METRICS_MAX_INTERFACES];
+};
+
+static void collectStats(const char *name, const PluckyInterfaceStats &stats, void *ctx) {
+  MetricsSnapshot *snapshot = (MetricsSnapshot *)ctx;
+  if (snapshot->count < METRICS_MAX_INTERFACES) {
+    snprintf(snapshot->names[snapshot->count], sizeof(snapshot->names[0]), "%s", name);
+    snapshot->stats[snapshot->count] = stats;
+    snapshot->count++;
+  }
+}
+
+struct CounterInfo {
+  const char *name;
+  const char *help;
+  size_t offset;
+};
+
+static const CounterInfo counters[] = {
+  { "plucky_interface_bytes_in_total", "Bytes received on the interface", offsetof(PluckyInterfaceStats, bytesIn) },
+  { "plucky_interface_bytes_out_total", "Bytes written to the interface", offsetof(PluckyInterfaceStats, bytesOut) },
+  { "plucky_interface_frames_in_total", "Frames received on the interface", offsetof(PluckyInterfaceStats, framesIn) },
+  { "plucky_interface_frames_out_total", "Frames written to the interface", offsetof(PluckyInterfaceStats, framesOut) },
+  { "plucky_interface_write_drops_total", "Frames dropped because the interface could not take them", offsetof(PluckyInterfaceStats, writeDrops) },
+  { "plucky_interface_overruns_total", "Read buffer overrun purges", offsetof(PluckyInterfaceStats, overruns) },
+  { "plucky_interface_crlf_fixes_total", "CRLF line endings converted to LF", offsetof(PluckyInterfaceStats, crlfFixes) },
+  { "plucky_interface_filter_drops_total", "Frames dropped or handled locally by filter rules", offsetof(PluckyInterfaceStats, filterDrops) },
+  { "plucky_interface_connects_total", "Clients accepted", offsetof(PluckyInterfaceStats, connects) },
+  { "plucky_interface_rejects_total", "Clients rejected for lack of a free slot", offsetof(PluckyInterfaceStats, rejects) },
+  { "plucky_interface_evictions_total", "Clients disconnected to make room for a new one", offsetof(PluckyInterfaceStats, evictions) },
+  { "plucky_interface_timeouts_total", "Clients disconnected for being idle", offsetof(PluckyInterfaceStats, timeouts) },
+};
+
+void printMetrics(Print &out) {
+  extern PluckyInterfaceSerial de1Serial;
+  extern PluckyInterface *de1;  // de1Serial, or the DE1 simulator standing in for it
+  extern PluckyInterfaceGroup controllers;
+
+  // Copy everything first so each metric's samples come from the same moment
+  static MetricsSnapshot snapshot;
+  snapshot.count = 0;
+  de1->visitStats(collectStats, &snapshot);
+  controllers.visitStats(collectStats, &snapshot);
+
+  for (size_t c = 0; c < sizeof(counters) / sizeof(counters[0]); c++) {
+    out.printf("# HELP %s %s\n# TYPE %s counter\n", counters[c].name, counters[c].help, counters[c].name);
+    for (uint8_t i = 0; i < snapshot.count; i++) {
+      uint32_t value = *(const uint32_t *)((const uint8_t *)&snapshot.stats[i] + counters[c].offset);
+      out.printf("%s{interface=\"%s\"} %u\n", counters[c].name, snapshot.names[i], value);
+    }
+  }
+
+  PluckyCommandQueue *commands = (de1 == &de1Serial) ? de1Serial.getCommandQueue() : NULL;
+  if (commands) {
+    static const struct { const char *name; const char *help; size_t offset; } laneCounters[] = {
+      { "plucky_de1_queue_queued_total", "Frames queued toward the DE1, by sender", offsetof(PluckyCommandLaneStats, queued) },
+      { "plucky_de1_queue_dropped_total", "Frames refused because the sender's DE1 queue lane was full", offsetof(PluckyCommandLaneStats, dropped) },
+      { "plucky_de1_queue_sent_total", "Queued frames written to the DE1 UART, by sender", offsetof(PluckyCommandLaneStats, sent) },
+    };
+    for (size_t c = 0; c < sizeof(laneCounters) / sizeof(laneCounters[0]); c++) {
+      out.printf("# HELP %s %s\n# TYPE %s counter\n", laneCounters[c].name, laneCounters[c].help, laneCounters[c].name);
+      for (uint8_t lane = 0; lane < DE1_QUEUE_NUM_LANES; lane++) {
+        char nameBuf[8];
+        uint32_t value = *(const uint32_t *)((const uint8_t *)&commands->getStats(lane) + laneCounters[c].offset);
+        out.printf("%s{lane=\"%s\"} %u\n", laneCounters[c].name, PluckyCommandQueue::laneName(lane, nameBuf, sizeof(nameBuf)), value);
+      }
+    }
+  }
+
+  extern PluckyInterfaceTcpPort *tcpPort;
+  out.printf("# HELP plucky_tcp_clients Connected TCP clients\n# TYPE plucky_tcp_clients gauge\n");
+  out.printf("plucky_tcp_clients %u\n", tcpPort->getClientCount());
+  out.printf("# HELP plucky_tcp_pool_limit Most TCP clients allowed at once\n# TYPE plucky_tcp_pool_limit gauge\n");
+  out.printf("plucky_tcp_pool_limit %u\n", tcpPort->getPoolLimit());
+  out.printf("# HELP plucky_tcp_pool_allocated Client slots allocated so far\n# TYPE plucky_tcp_pool_allocated gauge\n");
+  out.printf("plucky_tcp_pool_allocated %u\n", tcpPort->getAllocatedCount());
+
+  extern PluckyShotRecorder shotRecorder;
+  out.printf("# HELP plucky_shots_recorded_total Espresso shots recorded\n# TYPE plucky_shots_recorded_total counter\n");
+  out.printf("plucky_shots_recorded_total %u\n", shotRecorder.getShots());
+  out.printf("# HELP plucky_shot_frames_dropped_total Shot frames dropped because the staging buffer was full\n# TYPE plucky_shot_frames_dropped_total counter\n");
+  out.printf("plucky_shot_frames_dropped_total %u\n", shotRecorder.getDrops());
+  out.printf("# HELP plucky_shot_staged_bytes Shot bytes waiting to be written to flash\n# TYPE plucky_shot_staged_bytes gauge\n");
+  out.printf("plucky_shot_staged_bytes %u\n", shotRecorder.staged());
+
+  out.printf("# HELP plucky_free_heap_bytes Free heap\n# TYPE plucky_free_heap_bytes gauge\n");
+  out.printf("plucky_free_heap_bytes %u\n", esp_get_free_heap_size());
+  out.printf("# HELP plucky_uptime_seconds Time since boot\n# TYPE plucky_uptime_seconds gauge\n");
+  out.printf("plucky_uptime_seconds %lu\n", millis() / 1000);
+}
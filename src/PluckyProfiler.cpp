@@ -0,0 +1,74 @@
+#include <Arduino.h>
+
+#include "PluckyProfiler.hpp"
+
+void PluckyLatencyHistogram::reset() {
+  memset(_buckets, 0, sizeof(_buckets));
+  _count = 0;
+  _max = 0;
+}
+
+uint32_t PluckyLatencyHistogram::_bucketUpperBound(uint8_t bucket) {
+  if (bucket < 2) {
+    return bucket;
+  }
+  uint8_t msb = bucket >> 1;
+  uint32_t halfStep = 1UL << (msb - 1);
+  uint32_t lower = (1UL << msb) | ((bucket & 1) ? halfStep : 0);
+  return lower + (halfStep - 1);
+}
+
+uint32_t PluckyLatencyHistogram::percentile(float p) const {
+  if (_count == 0) {
+    return 0;
+  }
+  uint32_t target = (uint32_t)(p * _count + 0.5f);
+  if (target < 1) {
+    target = 1;
+  }
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < PROFILER_NUM_BUCKETS; b++) {
+    seen += _buckets[b];
+    if (seen >= target) {
+      uint32_t upper = _bucketUpperBound(b);
+      return (upper < _max) ? upper : _max;
+    }
+  }
+  return _max;
+}
+
+static struct {
+  char name[PROFILER_NAME_SIZE];
+  PluckyLatencyHistogram *histogram;
+} registry[PROFILER_MAX_HISTOGRAMS];
+static uint8_t numRegistered = 0;
+
+void profilerRegister(const char *name, PluckyLatencyHistogram *histogram) {
+  if (numRegistered >= PROFILER_MAX_HISTOGRAMS) {
+    return;
+  }
+  snprintf(registry[numRegistered].name, PROFILER_NAME_SIZE, "%s", name);
+  registry[numRegistered].histogram = histogram;
+  numRegistered++;
+}
+
+void profilerPrint(Print &out) {
+#if ENABLE_LOOP_PROFILER
+  uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+  out.printf("%-24s %10s %10s %10s %10s\n", "phase", "count", "p50 us", "p99 us", "max us");
+  for (uint8_t i = 0; i < numRegistered; i++) {
+    const PluckyLatencyHistogram *h = registry[i].histogram;
+    out.printf("%-24s %10u %10.1f %10.1f %10.1f\n", registry[i].name, h->count(),
+      (float)h->percentile(0.50f) / cyclesPerUs, (float)h->percentile(0.99f) / cyclesPerUs, 
+      (float)h->max() / cyclesPerUs);
+  }
+#else
+  out.println("Loop profiler disabled (ENABLE_LOOP_PROFILER)");
+#endif // ENABLE_LOOP_PROFILER
+}
+
+void profilerReset() {
+  for (uint8_t i = 0; i < numRegistered; i++) {
+    registry[i].histogram->reset();
+  }
+}
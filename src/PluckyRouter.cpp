@@ -0,0 +1,115 @@
+#include <Arduino.h>
+#include <ArduinoSimpleLogging.h>
+#include <string.h>
+
+#include "PluckyRouter.hpp"
+#include "PluckySettings.hpp"
+
+static const char *endpointNames[ROUTE_NUM_ENDPOINTS] = { "DE1", "USB", "BLE", "TCP", "WS", "UDP" };
+
+PluckyRouter::PluckyRouter() {
+  for (int i = 0; i < ROUTE_NUM_ENDPOINTS; i++) {
+    _endpoints[i] = NULL;
+    _routes[i] = 0;
+    _prefixedRoutes[i] = 0;
+  }
+}
+
+void PluckyRouter::attach(uint8_t id, PluckyInterface *iface) {
+  _endpoints[id] = iface;
+}
+
+const char *PluckyRouter::endpointName(uint8_t id) {
+  return (id < ROUTE_NUM_ENDPOINTS) ? endpointNames[id] : "?";
+}
+
+int PluckyRouter::endpointId(const char *name, size_t len) {
+  for (int i = 0; i < ROUTE_NUM_ENDPOINTS; i++) {
+    if (strlen(endpointNames[i]) == len && strncasecmp(name, endpointNames[i], len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void PluckyRouter::_applyRoutes(const char *spec, uint8_t *routes) {
+  const char *p = spec;
+  while (*p) {
+    while (*p == ' ' || *p == ',') {
+      p++;
+    }
+    const char *term = p;
+    while (*p && *p != ' ' && *p != ',') {
+      p++;
+    }
+    if (p == term) {
+      break;
+    }
+
+    bool remove = (*term == '!');
+    const char *src = remove ? term + 1 : term;
+    const char *arrow = (const char *)memchr(src, '>', p - src);
+    int from = arrow ? endpointId(src, arrow - src) : -1;
+    int to = arrow ? endpointId(arrow + 1, p - arrow - 1) : -1;
+    if (from < 0 || to < 0) {
+      Logger.warning.printf("WARNING: Ignoring unknown route %.*s\n", (int)(p - term), term);
+      continue;
+    }
+    if (remove) {
+      routes[from] &= ~ROUTE_BIT(to);
+    } else {
+      routes[from] |= ROUTE_BIT(to);
+    }
+  }
+}
+
+void PluckyRouter::rebuild() {
+  extern PluckySettings userSettings;
+  bool promiscuous = userSettings.promiscuous;
+
+  uint8_t routes[ROUTE_NUM_ENDPOINTS];
+  uint8_t prefixedRoutes[ROUTE_NUM_ENDPOINTS];
+  routes[ROUTE_DE1] = ROUTE_CONTROLLERS;
+  prefixedRoutes[ROUTE_DE1] = 0;
+  for (int i = ROUTE_DE1 + 1; i < ROUTE_NUM_ENDPOINTS; i++) {
+    routes[i] = ROUTE_BIT(ROUTE_DE1);
+    prefixedRoutes[i] = promiscuous ? ROUTE_CONTROLLERS : 0;
+  }
+  _applyRoutes(userSettings.routes, routes);
+
+  for (int i = 0; i < ROUTE_NUM_ENDPOINTS; i++) {
+    _routes[i] = routes[i];
+    _prefixedRoutes[i] = prefixedRoutes[i];
+
+    char dests[32] = "";
+    for (int j = 0; j < ROUTE_NUM_ENDPOINTS; j++) {
+      if (routes[i] & ROUTE_BIT(j)) {
+        strcat(dests, " ");
+        strcat(dests, endpointNames[j]);
+      }
+    }
+    Logger.info.printf("Route %s ->%s%s\n", endpointNames[i], dests, prefixedRoutes[i] ? " (+ promiscuous)" : "");
+  }
+}
+
+void PluckyRouter::dispatch(uint8_t source, uint8_t sender, const uint8_t *prefix, size_t prefixLen, const uint8_t *buf, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  uint8_t mask = _routes[source];
+  while (mask) {
+    int id = __builtin_ctz(mask);
+    mask &= mask - 1;
+    if (_endpoints[id]) {
+      _endpoints[id]->writeAllFrom(sender, buf, len);
+    }
+  }
+  mask = _prefixedRoutes[source];
+  while (mask) {
+    int id = __builtin_ctz(mask);
+    mask &= mask - 1;
+    if (_endpoints[id]) {
+      _endpoints[id]->writeAllPrefixed(prefix, prefixLen, buf, len);
+    }
+  }
+}
@@ -0,0 +1,141 @@
+#include <ArduinoSimpleLogging.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PluckySettings.hpp"
+#include "PluckyInterfaceTcpPort.hpp"
+#include "config.hpp"
+
+extern char *userSettingStr_promiscuous;
+extern char *userSettingStr_routes;
+extern char *userSettingStr_bleFlowControl;
+extern char *userSettingStr_tcpPort;
+extern char *userSettingStr_tcpOverflowPolicy;
+extern char *userSettingStr_tcpCoalesceMs;
+extern char *userSettingStr_tcpCoalesceBytes;
+extern char *userSettingStr_tcpMaxClients;
+extern char *userSettingStr_tcpIdleTimeoutS;
+extern char *userSettingStr_udpAddress;
+extern char *userSettingStr_udpPort;
+
+// In SETTING_* bit order
+static const char *settingNames[SETTING_NUM_SETTINGS] = {
+  "promiscuous", "routes", "bleFlowControl", "tcpPort", "tcpOverflowPolicy", "tcpCoalesceMs",
+  "tcpCoalesceBytes", "tcpMaxClients", "tcpIdleTimeoutS", "udpAddress", "udpPort"
+};
+
+// A whole-number setting, clamped to min..max; the default if it isn't a number
+static long parseInt(const char *name, const char *str, long min, long max, const char *fallback) {
+  char *end;
+  long value = strtol(str, &end, 10);
+  while (*end == ' ') {
+    end++;
+  }
+  if (end == str || *end != 0) {
+    Logger.warning.printf("WARNING: Setting %s \"%s\" is not a number; using %s\n", name, str, fallback);
+    value = strtol(fallback, NULL, 10);
+  }
+  if (value < min || value > max) {
+    long clamped = (value < min) ? min : max;
+    Logger.warning.printf("WARNING: Setting %s %ld is outside %ld..%ld; using %ld\n", name, value, min, max, clamped);
+    value = clamped;
+  }
+  return value;
+}
+
+template <typename T> static void update(T &field, T value, uint32_t bit, uint32_t &changed) {
+  if (field != value) {
+    field = value;
+    changed |= bit;
+  }
+}
+
+static void updateStr(char *field, size_t size, const char *value, uint32_t bit, uint32_t &changed) {
+  if (strncmp(field, value, size - 1) != 0) {
+    snprintf(field, size, "%s", value);
+    changed |= bit;
+  }
+}
+
+PluckySettings::PluckySettings() {
+  promiscuous = false;
+  bleFlowControl = false;
+  tcpPort = 0;
+  tcpOverflowPolicy = 0;
+  tcpCoalesceMs = 0;
+  tcpCoalesceBytes = 0;
+  tcpMaxClients = 0;
+  tcpIdleTimeoutMs = 0;
+  udpPort = 0;
+  routes[0] = 0;
+  udpAddress[0] = 0;
+  _numSubscribers = 0;
+  _loaded = false;
+}
+
+uint32_t PluckySettings::reload() {
+  uint32_t changed = 0;
+  update(promiscuous, parseInt("promiscuous", userSettingStr_promiscuous, 0, 1, DEFAULT_PROMISCUOUS) == 1,
+    SETTING_PROMISCUOUS, changed);
+  updateStr(routes, sizeof(routes), userSettingStr_routes, SETTING_ROUTES, changed);
+  update(bleFlowControl, parseInt("bleFlowControl", userSettingStr_bleFlowControl, 0, 1, DEFAULT_BLE_FLOW_CONTROL) != 0,
+    SETTING_BLE_FLOW_CONTROL, changed);
+  update(tcpPort, (uint16_t)parseInt("tcpPort", userSettingStr_tcpPort, 1, 65535, DEFAULT_TCP_PORT),
+    SETTING_TCP_PORT, changed);
+  update(tcpOverflowPolicy, (uint8_t)parseInt("tcpOverflowPolicy", userSettingStr_tcpOverflowPolicy,
+    TCP_OVERFLOW_DROP_OLDEST, TCP_OVERFLOW_DISCONNECT, DEFAULT_TCP_OVERFLOW_POLICY), SETTING_TCP_OVERFLOW_POLICY, changed);
+  update(tcpCoalesceMs, (uint16_t)parseInt("tcpCoalesceMs", userSettingStr_tcpCoalesceMs, 0, 100, DEFAULT_TCP_COALESCE_MS),
+    SETTING_TCP_COALESCE_MS, changed);
+  update(tcpCoalesceBytes, (uint16_t)parseInt("tcpCoalesceBytes", userSettingStr_tcpCoalesceBytes, 64, 2048, DEFAULT_TCP_COALESCE_BYTES),
+    SETTING_TCP_COALESCE_BYTES, changed);
+  update(tcpMaxClients, (uint8_t)parseInt("tcpMaxClients", userSettingStr_tcpMaxClients, 1, TCP_MAX_CLIENTS, DEFAULT_TCP_MAX_CLIENTS),
+    SETTING_TCP_MAX_CLIENTS, changed);
+  update(tcpIdleTimeoutMs, (uint32_t)parseInt("tcpIdleTimeoutS", userSettingStr_tcpIdleTimeoutS, 0, 86400, DEFAULT_TCP_IDLE_TIMEOUT_S) * 1000,
+    SETTING_TCP_IDLE_TIMEOUT, changed);
+  updateStr(udpAddress, sizeof(udpAddress), userSettingStr_udpAddress, SETTING_UDP_ADDRESS, changed);
+  update(udpPort, (uint16_t)parseInt("udpPort", userSettingStr_udpPort, 1, 65535, DEFAULT_UDP_PORT),
+    SETTING_UDP_PORT, changed);
+
+  if (!_loaded) {
+    _loaded = true;
+    changed = (1UL << SETTING_NUM_SETTINGS) - 1;
+  } else if (changed) {
+    char names[128] = "";
+    for (int i = 0; i < SETTING_NUM_SETTINGS; i++) {
+      if (changed & (1UL << i)) {
+        strncat(names, " ", sizeof(names) - strlen(names) - 1);
+        strncat(names, settingNames[i], sizeof(names) - strlen(names) - 1);
+      }
+    }
+    Logger.info.printf("Settings changed:%s\n", names);
+  }
+
+  for (uint8_t i = 0; i < _numSubscribers; i++) {
+    if (changed & _subscribers[i].mask) {
+      _subscribers[i].fn(changed & _subscribers[i].mask, _subscribers[i].ctx);
+    }
+  }
+  return changed;
+}
+
+bool PluckySettings::subscribe(uint32_t mask, PluckySettingsListener fn, void *ctx) {
+  if (_numSubscribers >= SETTINGS_MAX_SUBSCRIBERS) {
+    Logger.warning.printf("WARNING: More than %d settings subscribers; changes won't reach the rest live\n", SETTINGS_MAX_SUBSCRIBERS);
+    return false;
+  }
+  _subscribers[_numSubscribers].mask = mask;
+  _subscribers[_numSubscribers].fn = fn;
+  _subscribers[_numSubscribers].ctx = ctx;
+  _numSubscribers++;
+  return true;
+}
+
+void PluckySettings::unsubscribe(void *ctx) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < _numSubscribers; i++) {
+    if (_subscribers[i].ctx != ctx) {
+      _subscribers[kept++] = _subscribers[i];
+    }
+  }
+  _numSubscribers = kept;
+}
@@ -0,0 +1,157 @@
+#include <Arduino.h>
+#include <string.h>
+
+#include "PluckyShotRecorder.hpp"
+#include "PluckyFrameCodec.hpp"
+#include "PluckyDe1State.hpp"
+
+PluckyShotRecorder::PluckyShotRecorder() : _head(0), _tail(0), _endHead(0), _endTail(0), _nextShot(1) {
+  _recording = false;
+  _startMs = 0;
+  _lastMs = 0;
+  _frames = 0;
+  _drops = 0;
+  _shots = 0;
+  _totalFrames = 0;
+  _totalDrops = 0;
+  _skippedShots = 0;
+}
+
+void PluckyShotRecorder::record(const uint8_t *buf, size_t len) {
+  uint32_t now = millis();
+  // The machine state from a "[N]<state><substate>" frame, or -1 for any other frame
+  int state = frameTagByte(buf, len, '[', 'N');
+  if (!_recording) {
+    if (state == DE1_STATE_ESPRESSO) {
+      _begin(now);
+    }
+    return;
+  }
+  _stage(now, buf, len);
+  if ((state >= 0 && state != DE1_STATE_ESPRESSO) || now - _startMs >= SHOT_MAX_DURATION_MS) {
+    _end(now);
+  }
+}
+
+void PluckyShotRecorder::_begin(uint32_t now) {
+  PluckyShotHeader header;
+  header.magic = SHOT_MAGIC;
+  header.version = SHOT_VERSION;
+  header.headerSize = sizeof(header);
+  header.shotNumber = _nextShot.load(std::memory_order_relaxed);
+  header.startMs = now;
+  if (_endTail.load(std::memory_order_relaxed) - _endHead.load(std::memory_order_acquire) >= SHOT_MAX_PENDING_ENDS ||
+      !_push(&header, sizeof(header), sizeof(PluckyShotTrailer))) {
+    // The writer is still busy with earlier shots
+    _skippedShots++;
+    return;
+  }
+  _nextShot.store(header.shotNumber + 1, std::memory_order_relaxed);
+  _recording = true;
+  _startMs = now;
+  _lastMs = now;
+  _frames = 0;
+  _drops = 0;
+  _shots++;
+
+  // What the machine looked like going in, including the [N] that started the shot
+  extern PluckyDe1State de1State;
+  uint8_t frame[DE1_STATE_FRAME_SIZE];
+  for (int tag = 0; tag < DE1_NUM_TAGS; tag++) {
+    size_t len = de1State.get(tag, frame);
+    if (len > 0) {
+      _stage(now, frame, len);
+    }
+  }
+}
+
+void PluckyShotRecorder::_end(uint32_t now) {
+  PluckyShotTrailer trailer;
+  trailer.mark = SHOT_TRAILER_MARK;
+  trailer.numFrames = _frames;
+  trailer.droppedFrames = _drops;
+  trailer.durationMs = now - _startMs;
+  _push(&trailer, sizeof(trailer), 0);  // always fits: every other push left room for it
+
+  uint32_t endTail = _endTail.load(std::memory_order_relaxed);
+  _ends[endTail % SHOT_MAX_PENDING_ENDS] = _tail.load(std::memory_order_relaxed);
+  _endTail.store(endTail + 1, std::memory_order_release);
+  _recording = false;
+}
+
+// Stages one frame as a record; false (and counted) if it had to be dropped
+bool PluckyShotRecorder::_stage(uint32_t now, const uint8_t *frame, size_t len) {
+  uint8_t record[2 + PACKED_FRAME_MAX_SIZE];
+  uint32_t delta = now - _lastMs;
+  if (delta > SHOT_MAX_DELTA_MS) {
+    delta = SHOT_MAX_DELTA_MS;
+  }
+  record[0] = delta & 0xFF;
+  record[1] = delta >> 8;
+  size_t packedLen = packFrame(NULL, 0, frame, len, record + 2);
+  if (packedLen == 0 || !_push(record, 2 + packedLen, sizeof(PluckyShotTrailer))) {
+    _drops++;
+    _totalDrops++;
+    return false;
+  }
+  _lastMs = now;
+  _frames++;
+  _totalFrames++;
+  return true;
+}
+
+// Copies data into the ring if it fits with reserve bytes to spare, and publishes it
+bool PluckyShotRecorder::_push(const void *data, size_t len, size_t reserve) {
+  uint32_t tail = _tail.load(std::memory_order_relaxed);
+  size_t room = SHOT_STAGING_SIZE - (tail - _head.load(std::memory_order_acquire));
+  if (len + reserve > room) {
+    return false;
+  }
+  size_t offset = tail & (SHOT_STAGING_SIZE - 1);
+  size_t first = SHOT_STAGING_SIZE - offset;
+  if (first > len) {
+    first = len;
+  }
+  memcpy(&_ring[offset], data, first);
+  memcpy(_ring, (const uint8_t *)data + first, len - first);
+  _tail.store(tail + len, std::memory_order_release);
+  return true;
+}
+
+bool PluckyShotRecorder::chunkReady() {
+  return _endHead.load(std::memory_order_relaxed) != _endTail.load(std::memory_order_acquire) ||
+         staged() >= SHOT_WRITE_CHUNK;
+}
+
+bool PluckyShotRecorder::writeDue() {
+  return _endHead.load(std::memory_order_relaxed) != _endTail.load(std::memory_order_acquire) ||
+         staged() >= SHOT_DEFER_LIMIT;
+}
+
+size_t PluckyShotRecorder::take(uint8_t *out, size_t max, bool *endOfShot) {
+  // The end marker first: a shot's end is published after its last byte
+  uint32_t endHead = _endHead.load(std::memory_order_relaxed);
+  bool endPending = (endHead != _endTail.load(std::memory_order_acquire));
+  uint32_t head = _head.load(std::memory_order_relaxed);
+  size_t limit = _tail.load(std::memory_order_acquire) - head;
+  bool endInRange = false;
+  if (endPending && _ends[endHead % SHOT_MAX_PENDING_ENDS] - head <= limit) {
+    limit = _ends[endHead % SHOT_MAX_PENDING_ENDS] - head;
+    endInRange = true;
+  }
+  size_t len = (limit < max) ? limit : max;
+  *endOfShot = endInRange && len == limit;
+
+  size_t offset = head & (SHOT_STAGING_SIZE - 1);
+  size_t first = SHOT_STAGING_SIZE - offset;
+  if (first > len) {
+    first = len;
+  }
+  memcpy(out, &_ring[offset], first);
+  memcpy(out + first, _ring, len - first);
+  _head.store(head + len, std::memory_order_release);
+  if (*endOfShot) {
+    _endHead.store(endHead + 1, std::memory_order_release);
+  }
+  return len;
+}
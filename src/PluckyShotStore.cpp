@@ -0,0 +1,152 @@
+#include <SPIFFS.h>
+#include <ArduinoSimpleLogging.h>
+
+#include "PluckyShotStore.hpp"
+
+extern PluckyShotRecorder shotRecorder;
+
+static TaskHandle_t shotWriterHandle = NULL;
+
+// The lowest (up to max) shot numbers of the recordings on flash, ascending, and the
+// highest one.  Returns how many went into numbers.
+static int scanShots(uint32_t *numbers, int max, uint32_t *highest) {
+  int count = 0;
+  *highest = 0;
+  File root = SPIFFS.open("/");
+  File file = root.openNextFile();
+  while (file) {
+    // name() is the full path on some core versions and the bare name on others
+    const char *name = file.name();
+    const char *slash = strrchr(name, '/');
+    unsigned int n;
+    char ext[5];
+    if (sscanf(slash ? slash + 1 : name, "shot%u.%4s", &n, ext) == 2 && strcmp(ext, "plk") == 0) {
+      if (n > *highest) {
+        *highest = n;
+      }
+      int i = count;
+      if (count < max) {
+        count++;
+      } else if (n < numbers[max - 1]) {
+        i = max - 1;
+      } else {
+        i = -1;
+      }
+      for (; i > 0 && numbers[i - 1] > n; i--) {
+        numbers[i] = numbers[i - 1];
+      }
+      if (i >= 0) {
+        numbers[i] = n;
+      }
+    }
+    file = root.openNextFile();
+  }
+  return count;
+}
+
+// Makes room for a new recording and opens it
+static File openShot(uint32_t n) {
+  uint32_t numbers[SHOT_MAX_FILES];
+  uint32_t highest;
+  int count = scanShots(numbers, SHOT_MAX_FILES, &highest);
+  char path[24];
+  for (int i = 0; i < count && (count - i >= SHOT_MAX_FILES || SPIFFS.totalBytes() - SPIFFS.usedBytes() < SHOT_MIN_FREE_BYTES); i++) {
+    snprintf(path, sizeof(path), SHOT_FILE_FORMAT, numbers[i]);
+    SPIFFS.remove(path);
+    Logger.info.printf("Deleted shot recording %s to make room\n", path);
+  }
+  snprintf(path, sizeof(path), SHOT_FILE_FORMAT, n);
+  File file = SPIFFS.open(path, "w");
+  if (!file) {
+    Logger.warning.printf("WARNING: Could not create %s; shot %u not saved\n", path, n);
+  }
+  return file;
+}
+
+static void shotWriterTask(void *) {
+  static uint8_t chunk[SHOT_WRITE_CHUNK];
+  File file;
+  bool discarding = false;  // the rest of the current shot, after a failed open or write
+  uint32_t longestWriteUs = 0;
+  for (;;) {
+    while (shotRecorder.writeDue() && shotRecorder.chunkReady()) {
+      bool endOfShot;
+      size_t len = shotRecorder.take(chunk, sizeof(chunk), &endOfShot);
+      if (!file && !discarding) {
+        // Every shot's bytes start with its header
+        PluckyShotHeader header;
+        memcpy(&header, chunk, sizeof(header));
+        file = openShot(header.shotNumber);
+        discarding = !file;
+      }
+      if (file) {
+        uint32_t started = micros();
+        size_t written = file.write(chunk, len);
+        uint32_t took = micros() - started;
+        if (took > longestWriteUs) {
+          longestWriteUs = took;
+        }
+        if (written != len) {
+          Logger.warning.printf("WARNING: Writing %s failed (flash full?); rest of the shot dropped\n", file.name());
+          file.close();
+          discarding = true;
+        }
+      }
+      if (endOfShot) {
+        if (file) {
+          Logger.info.printf("Shot recording %s saved, %u bytes, longest write %u us\n", file.name(), file.size(), longestWriteUs);
+          file.close();
+        }
+        discarding = false;
+        longestWriteUs = 0;
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(SHOT_WRITER_PERIOD_MS));
+  }
+}
+
+void shotStoreBegin() {
+  uint32_t numbers[SHOT_MAX_FILES];
+  uint32_t last;
+  int count = scanShots(numbers, SHOT_MAX_FILES, &last);
+  shotRecorder.setNextShotNumber(last + 1);
+  xTaskCreatePinnedToCore(shotWriterTask, "plucky_shots", SHOT_WRITER_TASK_STACK_SIZE, NULL,
+                          SHOT_WRITER_TASK_PRIORITY, &shotWriterHandle, SHOT_WRITER_TASK_CORE);
+  Logger.info.printf("Shot recorder ready: %d recordings on flash, next is shot %u\n", count, last + 1);
+}
+
+void shotStorePrintList(Print &out) {
+  uint32_t numbers[SHOT_MAX_FILES];
+  uint32_t highest;
+  int count = scanShots(numbers, SHOT_MAX_FILES, &highest);
+  out.printf("# %d recordings, %u shots since boot (%u frames dropped, %u shots skipped)%s\n", count,
+             shotRecorder.getShots(), shotRecorder.getDrops(), shotRecorder.getSkippedShots(),
+             shotRecorder.recording() ? ", recording now" : "");
+  out.printf("# %6s %8s %8s %8s %8s\n", "shot", "bytes", "frames", "dropped", "seconds");
+  for (int i = 0; i < count; i++) {
+    char path[24];
+    snprintf(path, sizeof(path), SHOT_FILE_FORMAT, numbers[i]);
+    File file = SPIFFS.open(path, "r");
+    if (!file) {
+      continue;
+    }
+    size_t size = file.size();
+    PluckyShotTrailer trailer;
+    trailer.mark = 0;
+    if (size >= sizeof(PluckyShotHeader) + sizeof(trailer) && file.seek(size - sizeof(trailer))) {
+      file.read((uint8_t *)&trailer, sizeof(trailer));
+    }
+    file.close();
+    if (trailer.mark == SHOT_TRAILER_MARK) {
+      out.printf("%8u %8u %8u %8u %8.1f\n", numbers[i], size, trailer.numFrames, trailer.droppedFrames,
+                 trailer.durationMs / 1000.0);
+    } else {
+      out.printf("%8u %8u %8s %8s %8s\n", numbers[i], size, "-", "-", "-");  // still being written
+    }
+  }
+}
+
+bool shotStorePath(uint32_t n, char *path, size_t size) {
+  snprintf(path, size, SHOT_FILE_FORMAT, n);
+  return SPIFFS.exists(path);
+}
@@ -1,10 +1,21 @@
 #include "PluckyWebConfig.hpp"
 #include "PluckyWebServer.hpp"
+#include "PluckySettings.hpp"
+#include "PluckyInterfaceTcpPort.hpp"
+#include "PluckyBootTimeline.hpp"
 #include "config.hpp"
 
 extern PluckyWebServer webServer;
 extern char *userSettingStr_bleFlowControl;
 extern char *userSettingStr_tcpPort;
+extern char *userSettingStr_tcpOverflowPolicy;
+extern char *userSettingStr_tcpCoalesceMs;
+extern char *userSettingStr_tcpCoalesceBytes;
+extern char *userSettingStr_tcpMaxClients;
+extern char *userSettingStr_tcpIdleTimeoutS;
+extern char *userSettingStr_udpAddress;
+extern char *userSettingStr_udpPort;
+extern char *userSettingStr_routes;
 
 PluckyWebConfig::PluckyWebConfig(WebServer *_ws) {
   // Initial name of the board. Used e.g. as SSID of the own Access Point.
@@ -13,6 +24,7 @@ PluckyWebConfig::PluckyWebConfig(WebServer *_ws) {
   _iotWebConf = new IotWebConf(_machineName, &_dnsServer, _ws, WIFI_DEFAULT_PASSWORD, CONFIG_VERSION);
   _iotWebConf->setConfigPin(WIFI_CONFIG_PIN);
   _iotWebConf->setWifiConnectionCallback(wifiConnectedHandler_CB);
+  _iotWebConf->setConfigSavedCallback(configSavedHandler_CB);
   _iotWebConf->setupUpdateServer(&_updateServer);
 }
 
@@ -31,8 +43,57 @@ void PluckyWebConfig::doInit() {
     "bleFlowControl", userSettingStr_bleFlowControl, USER_SETTING_INT_STR_LEN, "number", "0 or 1", 
     DEFAULT_BLE_FLOW_CONTROL, "", true);
 
+  IotWebConfSeparator *separator_TCP = new IotWebConfSeparator("TCP Config");
+  IotWebConfParameter *tcpOverflowPolicyParam = new IotWebConfParameter(
+    "TCP Client Overflow Policy<br/>(0 = drop oldest frames, 1 = drop newest frame, 2 = disconnect the slow client)", 
+    "tcpOverflowPolicy", userSettingStr_tcpOverflowPolicy, USER_SETTING_INT_STR_LEN, "number", "0, 1 or 2", 
+    DEFAULT_TCP_OVERFLOW_POLICY, "", true);
+  IotWebConfParameter *tcpCoalesceMsParam = new IotWebConfParameter(
+    "TCP Coalescing Window, ms<br/>(0 = send each frame immediately; 5-20 = batch frames into fewer packets)", 
+    "tcpCoalesceMs", userSettingStr_tcpCoalesceMs, USER_SETTING_INT_STR_LEN, "number", "0..100", 
+    DEFAULT_TCP_COALESCE_MS, "min='0' max='100'", true);
+  IotWebConfParameter *tcpCoalesceBytesParam = new IotWebConfParameter(
+    "TCP Coalescing Size Cap, bytes<br/>(send early once this much is waiting)", 
+    "tcpCoalesceBytes", userSettingStr_tcpCoalesceBytes, USER_SETTING_INT_STR_LEN, "number", "64..2048", 
+    DEFAULT_TCP_COALESCE_BYTES, "min='64' max='2048'", true);
+  IotWebConfParameter *tcpMaxClientsParam = new IotWebConfParameter(
+    "TCP Client Limit<br/>(when full, the slowest or longest idle client makes way for a new one)", 
+    "tcpMaxClients", userSettingStr_tcpMaxClients, USER_SETTING_INT_STR_LEN, "number", "1.." TCP_MAX_CLIENTS_STR, 
+    DEFAULT_TCP_MAX_CLIENTS, "min='1' max='" TCP_MAX_CLIENTS_STR "'", true);
+  IotWebConfParameter *tcpIdleTimeoutParam = new IotWebConfParameter(
+    "TCP Idle Timeout, s<br/>(disconnect clients silent this long; 0 = never)", 
+    "tcpIdleTimeoutS", userSettingStr_tcpIdleTimeoutS, USER_SETTING_INT_STR_LEN, "number", "0..86400", 
+    DEFAULT_TCP_IDLE_TIMEOUT_S, "min='0' max='86400'", true);
+
+  IotWebConfSeparator *separator_UDP = new IotWebConfSeparator("UDP Config");
+  IotWebConfParameter *udpAddressParam = new IotWebConfParameter(
+    "UDP Publish Address<br/>(multicast group such as 239.72.68.49, \"broadcast\", or one host; empty = off)", 
+    "udpAddress", userSettingStr_udpAddress, USER_SETTING_ADDRESS_STR_LEN, "text", "239.72.68.49", 
+    DEFAULT_UDP_ADDRESS, "", true);
+  IotWebConfParameter *udpPortParam = new IotWebConfParameter(
+    "UDP Publish Port", 
+    "udpPort", userSettingStr_udpPort, USER_SETTING_INT_STR_LEN, "number", "1..65535", 
+    DEFAULT_UDP_PORT, "min='1' max='65535'", true);
+
+  IotWebConfSeparator *separator_Routing = new IotWebConfSeparator("Routing Config");
+  IotWebConfParameter *routesParam = new IotWebConfParameter(
+    "Extra Routes<br/>(e.g. \"BLE&gt;TCP TCP&gt;BLE\" to mirror BLE and TCP; \"!DE1&gt;BLE\" removes a default route)", 
+    "routes", userSettingStr_routes, USER_SETTING_ROUTES_STR_LEN, "text", "SRC>DST ...", 
+    DEFAULT_ROUTES, "", true);
+
   _iotWebConf->addParameter(separator_BLE);
   _iotWebConf->addParameter(bleFlowControlParam);
+  _iotWebConf->addParameter(separator_TCP);
+  _iotWebConf->addParameter(tcpOverflowPolicyParam);
+  _iotWebConf->addParameter(tcpCoalesceMsParam);
+  _iotWebConf->addParameter(tcpCoalesceBytesParam);
+  _iotWebConf->addParameter(tcpMaxClientsParam);
+  _iotWebConf->addParameter(tcpIdleTimeoutParam);
+  _iotWebConf->addParameter(separator_UDP);
+  _iotWebConf->addParameter(udpAddressParam);
+  _iotWebConf->addParameter(udpPortParam);
+  _iotWebConf->addParameter(separator_Routing);
+  _iotWebConf->addParameter(routesParam);
 
   _iotWebConf->init();
 }
@@ -48,12 +109,20 @@ void PluckyWebConfig::_wifiConnectedHandler() {
     char *updatedMachineName = _iotWebConf->getThingName(); // pulls in the machine name if overrridden previously via web config
     WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
     WiFi.setHostname(updatedMachineName);      
+    bootMilestone("WiFi connected");
 }
 
 void PluckyWebConfig::wifiConnectedHandler_CB() {
   webServer._webConfig->_wifiConnectedHandler();
 } 
 
+void PluckyWebConfig::configSavedHandler_CB() {
+  // Everything takes effect immediately: the router, TCP port, BLE UART and UDP
+  // publisher are told about the settings they subscribed to, the rest is read as used
+  extern PluckySettings userSettings;
+  userSettings.reload();
+}
+
 void PluckyWebConfig::handleConfig_CB() {
   webServer._webConfig->_iotWebConf->handleConfig();
 }
\ No newline at end of file
@@ -1,13 +1,22 @@
 #include <WebServer.h>
 #include <ArduinoSimpleLogging.h>
 #include <WebServer.h>
+#include <StreamString.h>
 
 #include "PluckyWebServer.hpp"
 #include "PluckyInterfaceSerial.hpp"
+#include "PluckyDe1State.hpp"
+#include "PluckyMetrics.hpp"
+#include "PluckyProfiler.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyFilter.hpp"
+#include "PluckyBootTimeline.hpp"
+#include "PluckyShotStore.hpp"
 
 extern PluckyWebServer webServer;
 
 PluckyWebServer::PluckyWebServer(int port) {
+  _numAssets = 0;
   _ws = new WebServer(port);
   _webConfig = new PluckyWebConfig(_ws);
 }
@@ -49,14 +58,64 @@ String PluckyWebServer::_getContentType(String filename) {
   return "text/plain";
 }
 
-bool PluckyWebServer::_webPathExists(String path){
-  bool exists = false;
-  File file = SPIFFS.open(path, "r");
-  if(!file.isDirectory()){
-    exists = true;
+void PluckyWebServer::_loadAssetIndex() {
+  _numAssets = 0;
+  File manifest = SPIFFS.open(WEB_MANIFEST_PATH, "r");
+  if (!manifest || manifest.isDirectory()) {
+    Logger.warning.printf("No %s in SPIFFS (image not built with tools/build_data.py?), indexing files without ETags\n", WEB_MANIFEST_PATH);
+    _indexSpiffs();
+    return;
   }
-  file.close();
-  return exists;
+  while (manifest.available() && _numAssets < WEB_MAX_ASSETS) {
+    String line = manifest.readStringUntil('\n');
+    char path[64], etag[40], flag[8];
+    if (sscanf(line.c_str(), "%63s %39s %7s", path, etag, flag) != 3) {
+      continue;
+    }
+    PluckyWebAsset &asset = _assets[_numAssets++];
+    asset.path = path;
+    asset.etag = etag;
+    asset.gzipped = (strcmp(flag, "gz") == 0);
+  }
+  manifest.close();
+  Logger.info.printf("Indexed %d web assets from %s\n", _numAssets, WEB_MANIFEST_PATH);
+}
+
+void PluckyWebServer::_indexSpiffs() {
+  // Fallback for images without a manifest: one pass over the (flat) SPIFFS directory
+  File root = SPIFFS.open("/");
+  File file = root.openNextFile();
+  while (file && _numAssets < WEB_MAX_ASSETS) {
+    if (!file.isDirectory()) {
+      PluckyWebAsset &asset = _assets[_numAssets++];
+      // The full path, e.g. /b/css/bootstrap.min.css: path() from core 2.x on, where
+      // name() is only the last component; name() before that
+#if defined(ESP_ARDUINO_VERSION_MAJOR) && ESP_ARDUINO_VERSION_MAJOR >= 2
+      asset.path = file.path();
+#else
+      asset.path = file.name();
+#endif
+      if (!asset.path.startsWith("/")) {
+        asset.path = "/" + asset.path;
+      }
+      asset.etag = "";
+      asset.gzipped = asset.path.endsWith(".gz");
+      if (asset.gzipped) {
+        asset.path = asset.path.substring(0, asset.path.length() - 3);
+      }
+    }
+    file = root.openNextFile();
+  }
+  Logger.info.printf("Indexed %d web assets from SPIFFS\n", _numAssets);
+}
+
+const PluckyWebAsset *PluckyWebServer::_findAsset(const String &path) {
+  for (int i = 0; i < _numAssets; i++) {
+    if (_assets[i].path == path) {
+      return &_assets[i];
+    }
+  }
+  return NULL;
 }
 
 bool PluckyWebServer::_handleFileRead(String path) {
@@ -64,27 +123,61 @@ bool PluckyWebServer::_handleFileRead(String path) {
   if (path.endsWith("/")) {
     path += "index.htm";
   }
+  const PluckyWebAsset *asset = _findAsset(path);
+  if (!asset) {
+    return false;
+  }
+
   String contentType = _getContentType(path);
-  String pathWithGz = path + ".gz";
-  if (_webPathExists(pathWithGz) || _webPathExists(path)) {
-    if (_webPathExists(pathWithGz)) {
-      path += ".gz";
+  // Pages are revalidated on every load so they never go stale; css/images are reused for a day
+  if (contentType == "text/html") {
+    _ws->sendHeader("Cache-Control", "no-cache");
+  } else {
+    _ws->sendHeader("Cache-Control", "max-age=" WEB_ASSET_MAX_AGE);
+  }
+  if (asset->etag.length() > 0) {
+    _ws->sendHeader("ETag", asset->etag);
+    if (_ws->header("If-None-Match") == asset->etag) {
+      _ws->send(304, contentType, "");
+      return true;
     }
-    File file = SPIFFS.open(path, "r");
-    _ws->streamFile(file, contentType);
-    file.close();
-    return true;
   }
-  return false;
+
+  // streamFile adds Content-Encoding: gzip for .gz files
+  File file = SPIFFS.open(asset->gzipped ? path + ".gz" : path, "r");
+  if (!file) {
+    return false;
+  }
+  _ws->streamFile(file, contentType);
+  file.close();
+  return true;
 }
 
-void PluckyWebServer::doInit() {
+void PluckyWebServer::loadSettings() {
   _webConfig->doInit();
+}
+
+void PluckyWebServer::doInit() {
+  _loadAssetIndex();
+  _loadFilters();
+
+  // The WebServer only keeps request headers it was told about up front
+  const char *headerKeys[] = { "If-None-Match" };
+  _ws->collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
 
   // URL handlers for specific patterns
   _ws->on("/config", PluckyWebConfig::handleConfig_CB);
   _ws->on("/de1/wake", PluckyWebServer::handleWake_CB);
   _ws->on("/de1/sleep", PluckyWebServer::handleSleep_CB);
+  _ws->on("/de1/state", HTTP_GET, PluckyWebServer::handleDe1State_CB);
+  _ws->on("/metrics", HTTP_GET, PluckyWebServer::handleMetrics_CB);
+  _ws->on("/profile", HTTP_GET, PluckyWebServer::handleProfile_CB);
+  _ws->on("/trace", HTTP_GET, PluckyWebServer::handleTrace_CB);
+  _ws->on("/shots", HTTP_GET, PluckyWebServer::handleShots_CB);
+  _ws->on("/shot", HTTP_GET, PluckyWebServer::handleShot_CB);
+  _ws->on("/boot", HTTP_GET, PluckyWebServer::handleBoot_CB);
+  _ws->on("/filters", HTTP_GET, PluckyWebServer::handleFilters_CB);
+  _ws->on("/filters", HTTP_POST, PluckyWebServer::handleFiltersUpdate_CB);
 
 
   // URL Handler for everything else
@@ -94,13 +187,13 @@ void PluckyWebServer::doInit() {
   _ws->onNotFound(PluckyWebServer::handleNotFound_CB);
 }
 
-extern PluckyInterfaceSerial de1Serial;
+extern PluckyInterface *de1;
 void PluckyWebServer::handleWake_CB() {
   // This is a sad little proof of concept hack.   This should not be an HTTP GET
   // and the 302 is a lame workaround for that fact.  But - whatever, it demonstrates a 
   // web-initiated action on the machine.  Will be replaced with a proper API of some form
   Logger.info.print("Web initiated wake\n");
-  de1Serial.writeAll((uint8_t *)"<B>02\n", 7);
+  de1->writeAll((uint8_t *)"<B>02\n", 7);
   webServer._ws->sendHeader("Location", "/command.htm");
   webServer._ws->send(302, "text/plain", ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
   webServer._ws->client().stop(); // Stop is needed because we sent no content length
@@ -111,12 +204,148 @@ void PluckyWebServer::handleSleep_CB() {
   // and the 302 is a lame workaround for that fact.  But - whatever, it demonstrates a 
   // web-initiated action on the machine.  Will be replaced with a proper API of some form
   Logger.info.print("Web initiated sleep\n");
-  de1Serial.writeAll((uint8_t *)"<B>00\n", 7);
+  de1->writeAll((uint8_t *)"<B>00\n", 7);
   webServer._ws->sendHeader("Location", "/command.htm");
   webServer._ws->send(302, "text/plain", ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
   webServer._ws->client().stop(); // Stop is needed because we sent no content length
 }
 
+extern PluckyDe1State de1State;
+void PluckyWebServer::handleDe1State_CB() {
+  // The latest frame of each type from the DE1, one per line, exactly as sent on the wire
+  String body;
+  uint8_t frame[DE1_STATE_FRAME_SIZE + 1];
+  for (int tag = 0; tag < DE1_NUM_TAGS; tag++) {
+    size_t len = de1State.get(tag, frame);
+    if (len > 0) {
+      frame[len] = 0;
+      body += (char *)frame;
+    }
+  }
+  webServer._ws->sendHeader("Cache-Control", "no-store");
+  webServer._ws->send(200, "text/plain", body);
+}
+
+void PluckyWebServer::handleMetrics_CB() {
+  // Prometheus text exposition format
+  StreamString body;
+  printMetrics(body);
+  webServer._ws->send(200, "text/plain; version=0.0.4", body);
+}
+
+void PluckyWebServer::handleProfile_CB() {
+  // Loop timing histograms; /profile?reset also clears them after reporting
+  StreamString body;
+  profilerPrint(body);
+  if (webServer._ws->hasArg("reset")) {
+    profilerReset();
+    body += "(reset)\n";
+  }
+  webServer._ws->sendHeader("Cache-Control", "no-store");
+  webServer._ws->send(200, "text/plain", body);
+}
+
+void PluckyWebServer::handleBoot_CB() {
+  // When each startup milestone was reached
+  StreamString body;
+  bootTimelinePrint(body);
+  webServer._ws->sendHeader("Cache-Control", "no-store");
+  webServer._ws->send(200, "text/plain", body);
+}
+
+static void sendTraceContent(const uint8_t *buf, size_t len, void *ctx) {
+  ((WebServer *)ctx)->sendContent_P((const char *)buf, len);
+}
+
+extern PluckyFlightRecorder flightRecorder;
+void PluckyWebServer::handleTrace_CB() {
+  // Binary flight recorder dump; decode with tools/plucky_trace.py.
+  // Recording pauses while it is sent so the records don't change underneath us.
+  Logger.info.print("Web initiated trace download\n");
+  flightRecorder.freeze();
+  webServer._ws->sendHeader("Content-Disposition", "attachment; filename=\"plucky.trace\"");
+  webServer._ws->setContentLength(flightRecorder.traceSize());
+  webServer._ws->send(200, "application/octet-stream", "");
+  flightRecorder.writeTrace(sendTraceContent, webServer._ws);
+  flightRecorder.resume();
+}
+
+void PluckyWebServer::handleShots_CB() {
+  // The shot recordings on flash
+  StreamString body;
+  shotStorePrintList(body);
+  webServer._ws->sendHeader("Cache-Control", "no-store");
+  webServer._ws->send(200, "text/plain", body);
+}
+
+void PluckyWebServer::handleShot_CB() {
+  // One recording, /shot?n=<number>; decode with tools/plucky_shot.py
+  char path[24];
+  if (!shotStorePath(webServer._ws->arg("n").toInt(), path, sizeof(path))) {
+    webServer._ws->send(404, "text/plain", "No such shot; see /shots\n");
+    return;
+  }
+  File file = SPIFFS.open(path, "r");
+  if (!file) {
+    webServer._ws->send(404, "text/plain", "No such shot; see /shots\n");
+    return;
+  }
+  String disposition = String("attachment; filename=\"") + (path + 1) + "\"";
+  webServer._ws->sendHeader("Content-Disposition", disposition);
+  webServer._ws->streamFile(file, "application/octet-stream");
+  file.close();
+}
+
+extern PluckyFilter frameFilter;
+void PluckyWebServer::_loadFilters() {
+  // Site rules live in SPIFFS so they can change without a firmware build
+  File file = SPIFFS.open(FILTER_RULES_PATH, "r");
+  if (!file || file.isDirectory()) {
+    frameFilter.compile(NULL);
+    return;
+  }
+  String rules = file.readString();
+  file.close();
+  frameFilter.compile(rules.c_str());
+}
+
+void PluckyWebServer::handleFilters_CB() {
+  // The rules in effect, with hit counts
+  StreamString body;
+  frameFilter.printRules(body);
+  webServer._ws->sendHeader("Cache-Control", "no-store");
+  webServer._ws->send(200, "text/plain", body);
+}
+
+void PluckyWebServer::handleFiltersUpdate_CB() {
+  // The request body replaces the site rules, e.g.
+  //   curl -u admin:<AP password> --data-binary @filters.txt http://plucky/filters
+  // Same credentials as the config page: rules can drop or rewrite anything sent to the DE1
+  const char *adminPassword = webServer._webConfig->_iotWebConf->getApPasswordParameter()->valueBuffer;
+  if (!webServer._ws->authenticate(IOTWEBCONF_ADMIN_USER_NAME, adminPassword)) {
+    webServer._ws->requestAuthentication();
+    return;
+  }
+  String rules = webServer._ws->arg("plain");
+  // Nothing is saved unless every rule in it would take effect
+  StreamString rejects;
+  int numRejects = frameFilter.check(rules.c_str(), rejects);
+  if (numRejects > 0) {
+    Logger.warning.printf("WARNING: Web filter rules update rejected, %d bad rules\n", numRejects);
+    webServer._ws->send(400, "text/plain", String(numRejects) + " rules could not be used, nothing saved:\n" + rejects);
+    return;
+  }
+  File file = SPIFFS.open(FILTER_RULES_PATH, "w");
+  if (!file) {
+    webServer._ws->send(500, "text/plain", "Could not write " FILTER_RULES_PATH "\n");
+    return;
+  }
+  file.print(rules);
+  file.close();
+  Logger.info.print("Web initiated filter rules update\n");
+  webServer._loadFilters();
+  handleFilters_CB();
+}
 
 void PluckyWebServer::doLoop() {
   _webConfig->doLoop();
@@ -3,67 +3,265 @@
 
 #include "PluckyWebServer.hpp"
 #include "PluckyInterfaceSerial.hpp"
+#include "PluckyInterfaceDe1Sim.hpp"
 #include "PluckyInterfaceGroup.hpp"
 #include "PluckyInterfaceTcpPort.hpp"
+#include "PluckyInterfaceWebSocket.hpp"
+#include "PluckyInterfaceUdpPublisher.hpp"
+#include "PluckyInterfaceCrossCore.hpp"
+#include "PluckyBridgeTask.hpp"
+#include "PluckyDe1State.hpp"
+#include "PluckyProfiler.hpp"
+#include "PluckyFlightRecorder.hpp"
+#include "PluckyRouter.hpp"
+#include "PluckyFilter.hpp"
+#include "PluckyBootTimeline.hpp"
+#include "PluckySettings.hpp"
+#include "PluckyShotRecorder.hpp"
+#include "PluckyShotStore.hpp"
 
 #include "config.hpp"
 char *userSettingStr_bleFlowControl;
 char *userSettingStr_tcpPort;
 char *userSettingStr_promiscuous;
+char *userSettingStr_routes;
+char *userSettingStr_tcpOverflowPolicy;
+char *userSettingStr_tcpCoalesceMs;
+char *userSettingStr_tcpCoalesceBytes;
+char *userSettingStr_tcpMaxClients;
+char *userSettingStr_tcpIdleTimeoutS;
+char *userSettingStr_udpAddress;
+char *userSettingStr_udpPort;
+
+// The settings above parsed into native values, see PluckySettings.hpp
+PluckySettings userSettings;
 
 // Web Server using SPIFFS and IotWebConfig
 PluckyWebServer webServer;
 
 // Interface for the DE1
 PluckyInterfaceSerial de1Serial(SERIAL_DE_UART_NUM);
+#if ENABLE_DE1_SIMULATOR
+// Stands in for the DE1; de1Serial is never started
+PluckyInterfaceDe1Sim de1Sim;
+PluckyInterface *de1 = &de1Sim;
+#else
+PluckyInterface *de1 = &de1Serial;
+#endif // ENABLE_DE1_SIMULATOR
+
+// Latest frame of each type seen from the DE1
+PluckyDe1State de1State;
+
+// Recent frames from every interface, see /trace
+PluckyFlightRecorder flightRecorder;
+
+// Espresso shots, staged here and written to flash by the shot store, see /shots
+PluckyShotRecorder shotRecorder;
 
 // Interface Group including all controllers talking to the DE1
 // Controllers in the main group:
 // 0 = Serial USB
 // 1 = Serial BLE
 // 2 = TCP Port (a nested group that includes any/all open sockets)
-#define NUM_CONTROLLERS 3
+// 3 = WebSocket server (for browsers)
+// 4 = UDP publisher (send-only, for displays on a multicast group)
+#define NUM_CONTROLLERS 5
 PluckyInterfaceGroup controllers(NUM_CONTROLLERS);
+// The TCP port itself, for its pool gauges in /metrics (controllers[2] may be a wrapper)
+PluckyInterfaceTcpPort *tcpPort;
+
+// Which interfaces each interface's frames are forwarded to
+PluckyRouter router;
+
+// Per-frame drop/rewrite/tap/command rules, see /filters
+PluckyFilter frameFilter;
 
 bool de1Initialized = false;
 
+// Timing of each loop() phase, see /profile
+PluckyLatencyHistogram profileLoop;
+PluckyLatencyHistogram profileWeb;
+PluckyLatencyHistogram profileDe1;
+PluckyLatencyHistogram profileControllers;
+
 void setup() {
   Logger.addHandler(Logger.INFO, Serial);
+  bootMilestone("setup() started");
 
   userSettingStr_bleFlowControl = new char[USER_SETTING_INT_STR_LEN];
   userSettingStr_tcpPort = new char[USER_SETTING_INT_STR_LEN];
   userSettingStr_promiscuous = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_routes = new char[USER_SETTING_ROUTES_STR_LEN];
+  userSettingStr_tcpOverflowPolicy = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpCoalesceMs = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpCoalesceBytes = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpMaxClients = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_tcpIdleTimeoutS = new char[USER_SETTING_INT_STR_LEN];
+  userSettingStr_udpAddress = new char[USER_SETTING_ADDRESS_STR_LEN];
+  userSettingStr_udpPort = new char[USER_SETTING_INT_STR_LEN];
   sprintf(userSettingStr_bleFlowControl, DEFAULT_BLE_FLOW_CONTROL);
   sprintf(userSettingStr_tcpPort, DEFAULT_TCP_PORT);
   sprintf(userSettingStr_promiscuous, DEFAULT_PROMISCUOUS);
+  strcpy(userSettingStr_routes, DEFAULT_ROUTES);
+  sprintf(userSettingStr_tcpOverflowPolicy, DEFAULT_TCP_OVERFLOW_POLICY);
+  sprintf(userSettingStr_tcpCoalesceMs, DEFAULT_TCP_COALESCE_MS);
+  sprintf(userSettingStr_tcpCoalesceBytes, DEFAULT_TCP_COALESCE_BYTES);
+  sprintf(userSettingStr_tcpMaxClients, DEFAULT_TCP_MAX_CLIENTS);
+  sprintf(userSettingStr_tcpIdleTimeoutS, DEFAULT_TCP_IDLE_TIMEOUT_S);
+  strcpy(userSettingStr_udpAddress, DEFAULT_UDP_ADDRESS);
+  sprintf(userSettingStr_udpPort, DEFAULT_UDP_PORT);
+
+  // Everything the UART bridge needs, and nothing else, so the DE1 and the BLE tablet are
+  // talking again within milliseconds of power-up.  IotWebConf's init() only reads the
+  // saved config (e.g. BLE flow control) from EEPROM; WiFi starts on its first doLoop().
+  webServer.loadSettings();
+  userSettings.reload();
+  bootMilestone("settings loaded");
+
+  frameFilter.compile(NULL);  // the built-in rules, until the site rules are read from SPIFFS
+  controllers[0] = new PluckyInterfaceSerial(SERIAL_USB_UART_NUM);
+  controllers[1] = new PluckyInterfaceSerial(SERIAL_BLE_UART_NUM);
+#if ENABLE_DE1_SIMULATOR
+  de1Sim.setSpeed(DE1_SIM_SPEED);
+  de1Sim.setRepeat(DE1_SIM_REPEAT);
+#endif // ENABLE_DE1_SIMULATOR
+  de1->doInit();
+  controllers.initChild(0);
+  controllers.initChild(1);
+
+  router.attach(ROUTE_DE1, de1);
+  router.attach(ROUTE_USB, controllers[0]);
+  router.attach(ROUTE_BLE, controllers[1]);
+  router.rebuild();
+  userSettings.subscribe(SETTING_PROMISCUOUS | SETTING_ROUTES, PluckyRouter::settingsChanged_CB, &router);
+
+  profilerRegister("loop", &profileLoop);
+  profilerRegister("loop.web", &profileWeb);
+#if !ENABLE_DUAL_CORE_BRIDGE
+  profilerRegister("loop.de1", &profileDe1);
+#endif // !ENABLE_DUAL_CORE_BRIDGE
+  profilerRegister("loop.controllers", &profileControllers);
+
+#if ENABLE_DUAL_CORE_BRIDGE
+  // From here on the UARTs (DE1, USB, BLE) are serviced by the bridge task, not loop()
+#if ENABLE_DE1_SIMULATOR
+  static PluckyInterfaceSerial *bridgedInterfaces[] = { 
+    (PluckyInterfaceSerial *)controllers[0], (PluckyInterfaceSerial *)controllers[1] 
+  };
+  bridgeTaskBegin(bridgedInterfaces, 2, &de1Sim);
+#else
+  static PluckyInterfaceSerial *bridgedInterfaces[] = { 
+    &de1Serial, (PluckyInterfaceSerial *)controllers[0], (PluckyInterfaceSerial *)controllers[1] 
+  };
+  bridgeTaskBegin(bridgedInterfaces, 3);
+#endif // ENABLE_DE1_SIMULATOR
+#endif // ENABLE_DUAL_CORE_BRIDGE
+  bootMilestone("UART bridge live");
+}
 
+#if ENABLE_DE1_SIMULATOR
+// Hands DE1_SIM_SHOT_PATH to the simulator, which keeps its built-in shot without one
+static void loadDe1SimShot() {
+  File file = SPIFFS.open(DE1_SIM_SHOT_PATH, "r");
+  if (!file) {
+    Logger.info.printf("No %s; the simulated DE1 replays its built-in shot\n", DE1_SIM_SHOT_PATH);
+    return;
+  }
+  size_t len = file.size();
+  uint8_t *data = (uint8_t *)malloc(len);  // kept for good: the simulator replays from it
+  if (!data || file.read(data, len) != len || !de1Sim.load(data, len)) {
+    Logger.warning.printf("WARNING: Could not load %s as a shot recording; the simulated DE1 replays its built-in shot\n", DE1_SIM_SHOT_PATH);
+    free(data);
+  }
+  file.close();
+}
+#endif // ENABLE_DE1_SIMULATOR
+
+// The rest of startup, done by loop() one step per pass so the bridge keeps running 
+// in between (in single-core builds loop() is what services the UARTs)
+static void mountSpiffs() {
+  // Formats the partition on the very first boot, which takes a while
   if(!SPIFFS.begin(true)){
       Logger.error.println("An Error has occurred while mounting SPIFFS");
   }
-  controllers[0] = new PluckyInterfaceSerial(SERIAL_USB_UART_NUM);
-  controllers[1] = new PluckyInterfaceSerial(SERIAL_BLE_UART_NUM);
-  controllers[2] = new PluckyInterfaceTcpPort(atoi(userSettingStr_tcpPort));
+  bootMilestone("SPIFFS mounted");
+  shotStoreBegin();
+#if ENABLE_DE1_SIMULATOR
+  loadDe1SimShot();
+#endif // ENABLE_DE1_SIMULATOR
+}
 
-  de1Serial.doInit();
+static void startNetworkInterfaces() {
+#if ENABLE_DUAL_CORE_BRIDGE
+  // TCP stays on loop()'s core; DE1 frames reach it through a cross-core queue
+  tcpPort = new PluckyInterfaceTcpPort(userSettings.tcpPort);
+  controllers[2] = new PluckyInterfaceCrossCore(tcpPort);
+  controllers[3] = new PluckyInterfaceCrossCore(new PluckyInterfaceWebSocket());
+  controllers[4] = new PluckyInterfaceCrossCore(new PluckyInterfaceUdpPublisher());
+#else
+  tcpPort = new PluckyInterfaceTcpPort(userSettings.tcpPort);
+  controllers[2] = tcpPort;
+  controllers[3] = new PluckyInterfaceWebSocket();
+  controllers[4] = new PluckyInterfaceUdpPublisher();
+#endif // ENABLE_DUAL_CORE_BRIDGE
+  for (uint8_t i = 2; i < NUM_CONTROLLERS; i++) {
+    controllers.initChild(i);
+  }
 
-  controllers.doInit();
+  router.attach(ROUTE_TCP, controllers[2]);
+  router.attach(ROUTE_WEBSOCKET, controllers[3]);
+  router.attach(ROUTE_UDP, controllers[4]);
+  router.rebuild();
+  bootMilestone("network interfaces started");
+}
 
+static void startWebServer() {
+  // Asset index, site filter rules and URL handlers.  WiFi comes up from the next
+  // webServer.doLoop() on.
   webServer.doInit();
-
+  bootMilestone("web server ready");
   Logger.info.println("Plucky initialization completed.");
 }
 
+static void (*const deferredInitSteps[])() = { mountSpiffs, startNetworkInterfaces, startWebServer };
+#define NUM_DEFERRED_INIT_STEPS (sizeof(deferredInitSteps) / sizeof(deferredInitSteps[0]))
+static uint8_t deferredInitDone = 0;
+
 void loop() {
-  webServer.doLoop();
-  de1Serial.doLoop();
+  uint32_t loopStart = profilerNow();
+  if (deferredInitDone == NUM_DEFERRED_INIT_STEPS) {
+    webServer.doLoop();
+  }
+  uint32_t webDone = profilerNow();
+  profileWeb.record(webDone - loopStart);
+#if ENABLE_DUAL_CORE_BRIDGE
+  for (uint8_t i = 2; i < NUM_CONTROLLERS; i++) {
+    if (controllers[i]) {
+      controllers[i]->doLoop();
+    }
+  }
+  uint32_t de1Done = webDone;
+#else
+  de1->doLoop();
+  uint32_t de1Done = profilerNow();
+  profileDe1.record(de1Done - webDone);
   controllers.doLoop();
+#endif // ENABLE_DUAL_CORE_BRIDGE
+  uint32_t loopDone = profilerNow();
+  profileControllers.record(loopDone - de1Done);
+  profileLoop.record(loopDone - loopStart);
 
   if (!de1Initialized) {
 #if ENABLE_REMOTE_OOB
-      de1Serial.writeAll((uint8_t *)"[E]00000001\n", 12);
+      de1->writeAll((uint8_t *)"[E]00000001\n", 12);
       Logger.info.println("Remote Control enabled via factory command.");
 #endif //  ENABLE_REMOTE_OOB
   de1Initialized = true;
   Logger.info.println("DE1 (re-)initialized.");
+  bootMilestone("DE1 initialized");
+  }
+
+  if (deferredInitDone < NUM_DEFERRED_INIT_STEPS) {
+    deferredInitSteps[deferredInitDone++]();
   }
 }
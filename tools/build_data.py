@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Prepare the web assets in data/ for the SPIFFS image.
+
+Text assets are gzipped (the web server sends them with Content-Encoding: gzip),
+already-compressed ones (images) are copied as is, and a manifest listing every
+asset with its ETag is written next to them so the server can build its index
+without probing SPIFFS on each request.
+
+Runs automatically before `pio run -t buildfs` / `uploadfs` (see extra_scripts in
+platformio.ini), or by hand:
+
+    tools/build_data.py [source_dir] [output_dir]
+
+Manifest format (manifest.txt), one asset per line:
+    <url path> <etag> <gz|->
+"""
+
+import gzip
+import hashlib
+import os
+import shutil
+import sys
+
+MANIFEST_NAME = "manifest.txt"
+SPIFFS_MAX_PATH = 31  # SPIFFS_OBJ_NAME_LEN minus the terminator
+GZIP_EXTENSIONS = (".htm", ".html", ".css", ".js", ".json", ".map", ".svg", ".txt", ".xml")
+
+
+def build(src_dir, out_dir):
+    if os.path.isdir(out_dir):
+        shutil.rmtree(out_dir)
+    os.makedirs(out_dir)
+
+    manifest = []
+    total_in = total_out = 0
+    for root, _, files in os.walk(src_dir):
+        for name in sorted(files):
+            src = os.path.join(root, name)
+            url = "/" + os.path.relpath(src, src_dir).replace(os.sep, "/")
+            with open(src, "rb") as f:
+                content = f.read()
+            etag = '"%s"' % hashlib.sha1(content).hexdigest()[:16]
+
+            gzipped = name.endswith(GZIP_EXTENSIONS)
+            stored = url + ".gz" if gzipped else url
+            if len(stored) > SPIFFS_MAX_PATH:
+                sys.exit("%s: stored path %s is longer than SPIFFS allows (%d)" % (src, stored, SPIFFS_MAX_PATH))
+            if gzipped:
+                # mtime=0 keeps the image byte-identical between builds
+                content = gzip.compress(content, compresslevel=9, mtime=0)
+
+            dst = os.path.join(out_dir, stored.lstrip("/"))
+            os.makedirs(os.path.dirname(dst), exist_ok=True)
+            with open(dst, "wb") as f:
+                f.write(content)
+
+            total_in += os.path.getsize(src)
+            total_out += len(content)
+            manifest.append("%s %s %s\n" % (url, etag, "gz" if gzipped else "-"))
+
+    with open(os.path.join(out_dir, MANIFEST_NAME), "w") as f:
+        f.writelines(sorted(manifest))
+    print("web assets: %d files, %d -> %d bytes in %s" % (len(manifest), total_in, total_out, out_dir))
+
+
+try:
+    Import("env")  # noqa: F821 -- provided when run as a PlatformIO extra script
+except NameError:
+    if __name__ == "__main__":
+        here = os.path.dirname(os.path.abspath(__file__))
+        build(sys.argv[1] if len(sys.argv) > 1 else os.path.join(here, "..", "data"),
+              sys.argv[2] if len(sys.argv) > 2 else os.path.join(here, "..", ".pio", "data"))
+else:
+    if any(t in COMMAND_LINE_TARGETS for t in ("buildfs", "uploadfs", "uploadfsota")):  # noqa: F821
+        build(os.path.join(env.subst("$PROJECT_DIR"), "data"), env.subst("$PROJECT_DATA_DIR"))  # noqa: F821
@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+"""Decode a Plucky shot recording (GET /shot?n=<number>) into one line per DE1 frame.
+
+    curl -o shot.plk "http://<plucky>/shot?n=12"
+    tools/plucky_shot.py shot.plk
+
+Layout (little-endian, see include/PluckyShotRecorder.hpp):
+  header:  magic "PLKS", version u16, header size u16, shot number u32,
+           millis() at the start u32
+  records: ms since the previous record u16, then the packed frame
+           len u8 | kind u8 | tag u8 | data (include/PluckyFrameCodec.hpp)
+  trailer: 0xFFFF u16, frames u32, dropped frames u32, duration ms u32
+"""
+
+import argparse
+import struct
+import sys
+
+SHOT_MAGIC = 0x534B4C50
+SHOT_VERSION = 1
+HEADER = struct.Struct("<IHHII")
+TRAILER = struct.Struct("<HIII")
+DELTA = struct.Struct("<H")
+TRAILER_MARK = 0xFFFF
+PACKED_KIND_TEXT = 0
+CLOSING = {ord("["): "]", ord("<"): ">"}
+
+
+def unpack_frame(packed):
+    kind = packed[0]
+    if kind == PACKED_KIND_TEXT:
+        return "".join(chr(b) if 32 <= b < 127 else "\\x%02x" % b for b in packed[1:])
+    if kind not in CLOSING or len(packed) < 2:
+        raise ValueError("malformed packed frame")
+    return "%c%c%s%s" % (kind, packed[1], CLOSING[kind], packed[2:].hex().upper())
+
+
+def decode(data, out):
+    if len(data) < HEADER.size:
+        raise ValueError("recording too short for a header")
+    magic, version, header_size, shot, start_ms = HEADER.unpack_from(data, 0)
+    if magic != SHOT_MAGIC:
+        raise ValueError("not a Plucky shot recording (bad magic)")
+    if version != SHOT_VERSION:
+        raise ValueError("unsupported recording version %d" % version)
+
+    out.write("# shot %d, started at %d ms since boot\n" % (shot, start_ms))
+    out.write("# %8s  %s\n" % ("t ms", "frame"))
+    offset = header_size
+    t = 0
+    frames = 0
+    while offset + DELTA.size <= len(data):
+        (delta,) = DELTA.unpack_from(data, offset)
+        if delta == TRAILER_MARK:
+            break
+        if offset + DELTA.size + 1 > len(data):
+            break
+        length = data[offset + DELTA.size]
+        packed = data[offset + DELTA.size + 1:offset + DELTA.size + 1 + length]
+        if len(packed) < length:
+            break
+        t += delta
+        out.write("%10d  %s\n" % (t, unpack_frame(packed)))
+        frames += 1
+        offset += DELTA.size + 1 + length
+
+    if offset + TRAILER.size <= len(data):
+        mark, num_frames, dropped, duration_ms = TRAILER.unpack_from(data, offset)
+        if mark == TRAILER_MARK:
+            out.write("# %d frames, %d dropped, %.1f s\n" % (num_frames, dropped, duration_ms / 1000.0))
+            if num_frames != frames:
+                out.write("# trailer counts %d frames but %d were decoded\n" % (num_frames, frames))
+            return
+    out.write("# %d frames; no trailer (recording still in progress or cut short)\n" % frames)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("recording", help="recording downloaded from /shot?n=<number>")
+    args = parser.parse_args()
+    with open(args.recording, "rb") as f:
+        data = f.read()
+    try:
+        decode(data, sys.stdout)
+    except ValueError as e:
+        sys.exit("%s: %s" % (args.recording, e))
+
+
+if __name__ == "__main__":
+    main()
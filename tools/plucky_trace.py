@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""Decode a Plucky flight recorder trace (GET /trace) into one line per frame.
+
+    curl -o plucky.trace http://<plucky>/trace
+    tools/plucky_trace.py plucky.trace
+
+Layout (little-endian, see include/PluckyFlightRecorder.hpp):
+  header: magic "PLKT", version u16, record size u16, number of records u32,
+          total recorded u32, micros() at download u32
+  record: seq u32, timestamp us u32, source u8, dest u8, length u8, flags u8, payload
+"""
+
+import argparse
+import struct
+import sys
+
+TRACE_MAGIC = 0x544B4C50
+TRACE_VERSION = 1
+HEADER = struct.Struct("<IHHIII")
+RECORD_PREFIX = struct.Struct("<IIBBBB")
+FLAG_TRUNCATED = 0x01
+
+TRACE_ID_TCP_BASE = 16
+INTERFACE_NAMES = {
+    0: "-",
+    1: "DE1",
+    2: "USB",
+    3: "BLE",
+    4: "WebSocket",
+    15: "controllers",
+}
+
+
+def interface_name(trace_id):
+    if trace_id >= TRACE_ID_TCP_BASE:
+        return "TCP_%d" % (trace_id - TRACE_ID_TCP_BASE)
+    return INTERFACE_NAMES.get(trace_id, "if%d" % trace_id)
+
+
+def printable(payload):
+    return "".join(chr(b) if 32 <= b < 127 else "\\x%02x" % b for b in payload)
+
+
+def decode(data, out):
+    if len(data) < HEADER.size:
+        raise ValueError("trace too short for a header")
+    magic, version, record_size, num_records, total, now_us = HEADER.unpack_from(data, 0)
+    if magic != TRACE_MAGIC:
+        raise ValueError("not a Plucky trace (bad magic)")
+    if version != TRACE_VERSION:
+        raise ValueError("unsupported trace version %d" % version)
+    if len(data) < HEADER.size + num_records * record_size:
+        raise ValueError("trace truncated: expected %d records" % num_records)
+
+    out.write("# %d records, %d frames recorded since boot\n" % (num_records, total))
+    out.write("# %12s %10s %-12s %-12s %4s  %s\n" % ("seq", "t-now ms", "source", "dest", "len", "payload"))
+    first_seq = total - num_records
+    for i in range(num_records):
+        offset = HEADER.size + i * record_size
+        seq, ts, source, dest, length, flags = RECORD_PREFIX.unpack_from(data, offset)
+        payload = data[offset + RECORD_PREFIX.size:offset + record_size]
+        if seq != first_seq + i:
+            out.write("# record %d was being written during the download; skipped\n" % (first_seq + i))
+            continue
+        shown = payload[:min(length, len(payload))]
+        text = printable(shown.rstrip(b"\n"))
+        if flags & FLAG_TRUNCATED:
+            text += "..."
+        age_ms = ((ts - now_us) & 0xFFFFFFFF)
+        if age_ms >= 0x80000000:
+            age_ms -= 0x100000000
+        out.write("%14d %10.3f %-12s %-12s %4d  %s\n" % (
+            seq, age_ms / 1000.0, interface_name(source), interface_name(dest), length, text))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("trace", help="trace file downloaded from /trace")
+    args = parser.parse_args()
+    with open(args.trace, "rb") as f:
+        data = f.read()
+    try:
+        decode(data, sys.stdout)
+    except ValueError as e:
+        sys.exit("%s: %s" % (args.trace, e))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Listen to the DE1 frames Plucky publishes over UDP and count any that go missing.
+
+    tools/plucky_udp.py --group 239.72.68.49       # udpAddress set to that group
+    tools/plucky_udp.py                            # "broadcast", or this host's address
+
+Each datagram is "<8 hex digit sequence number> <frame>" (see
+include/PluckyInterfaceUdpPublisher.hpp).  A jump in the sequence number means
+datagrams were lost; a drop back to a lower number means the bridge restarted.
+
+Loopback harness: run this with --port 9091, then the native benchmark
+(`pio run -e native && .pio/build/native/program`), which publishes its
+"de1 -> udp" scenario to 127.0.0.1:9091.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+
+def open_socket(port, group, interface):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1 << 20)
+    sock.bind(("", port))
+    if group:
+        membership = struct.pack("4s4s", socket.inet_aton(group), socket.inet_aton(interface))
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+    return sock
+
+
+class LossCounter:
+    def __init__(self):
+        self.received = 0
+        self.lost = 0
+        self.restarts = 0
+        self.malformed = 0
+        self.expected = None
+
+    def add(self, sequence):
+        self.received += 1
+        if self.expected is not None:
+            if sequence > self.expected:
+                self.lost += sequence - self.expected
+            elif sequence < self.expected:
+                self.restarts += 1
+        self.expected = (sequence + 1) & 0xFFFFFFFF
+
+    def summary(self):
+        total = self.received + self.lost
+        return "%d received, %d lost (%.2f%%), %d restarts, %d malformed" % (
+            self.received, self.lost, 100.0 * self.lost / total if total else 0.0,
+            self.restarts, self.malformed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=9091, help="UDP port (udpPort setting, default 9091)")
+    parser.add_argument("--group", help="multicast group to join (udpAddress setting)")
+    parser.add_argument("--interface", default="0.0.0.0", help="local address to join the group on")
+    parser.add_argument("--quiet", "-q", action="store_true", help="don't print frames, only loss statistics")
+    parser.add_argument("--interval", type=float, default=5.0, help="seconds between statistics lines")
+    args = parser.parse_args()
+
+    sock = open_socket(args.port, args.group, args.interface)
+    counter = LossCounter()
+    next_report = time.monotonic() + args.interval
+    sock.settimeout(args.interval)
+    try:
+        while True:
+            try:
+                datagram = sock.recv(2048)
+            except socket.timeout:
+                datagram = None
+            if datagram:
+                try:
+                    sequence = int(datagram[:8], 16)
+                    if datagram[8:9] != b" ":
+                        raise ValueError
+                except ValueError:
+                    counter.malformed += 1
+                else:
+                    counter.add(sequence)
+                    if not args.quiet:
+                        sys.stdout.write("%08x %s" % (sequence, datagram[9:].decode("ascii", "replace")))
+            if time.monotonic() >= next_report:
+                next_report = time.monotonic() + args.interval
+                sys.stderr.write("udp: %s\n" % counter.summary())
+    except KeyboardInterrupt:
+        pass
+    sys.stderr.write("udp: %s\n" % counter.summary())
+
+
+if __name__ == "__main__":
+    main()